@@ -0,0 +1,59 @@
+#include "otd_CorePeri.h"
+#include "otd_DigitalIO.h"
+#include "otd_Pulse.h"
+#include "otd_Analog.h"
+#include "otd_Modbus.h"
+
+/*
+ * Modbus RTU slave with address 1 at 19200 baud.
+ * Digital inputs, outputs, pulse outputs and the load cell are accessed by the PLC.
+ * Register map is in "otd_Modbus.h".
+ */
+
+void setup() {
+  // Call this function even to reset the MCUSR
+  getLastResetCause();
+  
+  // Initialize core peripherals
+  otd_InitCorePeri();
+
+  // Initialize I/O
+  otd_InitDigitalIO();
+  otd_OutputEnable();
+  otd_InitPulse();
+  otd_InitAnalog();
+
+  // Initialize Modbus slave
+  otd_InitModbus(1);
+}
+
+void loop() {
+
+  // Configure analog for the load cell
+  otd_SetAnalogType(OTD_ANALOG_VOLTAGE);
+  otd_SetAnalogChannel(OTD_ANALOG_DIFF_1);
+  otd_SetAnalogDataRate(OTD_ANALOG_DATARATE_15Hz);
+  otd_SetAnalogGain(OTD_ANALOG_GAIN_128);
+
+  unsigned long analogLastTS = 0;     // Time stamp for last analog check in ms
+  unsigned long currentTS;            // Current time stamp in ms
+  //
+  const unsigned int analogCheckDiff = 10;  // Analog data is checked every 10ms
+
+  // Infinite loop
+  while(1){
+    // Answer the requests, call it as often as possible
+    otd_ModbusPoll();
+
+    // Analog task
+    currentTS = getUptime_ms();
+    if (currentTS-analogLastTS > analogCheckDiff){
+      if (otd_IsAnalogDataReady() == 1){
+        // Input registers 0..4 are updated
+        otd_ModbusUpdateAnalog(otd_AnalogRead());
+      }
+      analogLastTS = currentTS;
+    }
+  }
+  
+}
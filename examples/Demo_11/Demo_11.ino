@@ -0,0 +1,70 @@
+#include "otd_CorePeri.h"
+#include "otd_DigitalIO.h"
+#include "otd_Analog.h"
+#include "otd_Modbus.h"
+
+/*
+ * Many boards on one RS-485 line, each one a Modbus RTU slave at 19200 baud.
+ * Node ID is kept in EEPROM, program it once per board with otd_NodeIdSave().
+ * DIGITAL_OUTPUT_6 (PD3) drives the DE/RE pins of the transceiver, do not use it as an output.
+ * It is left out of the Modbus coils, so coils 0..4 can be written and coil 5 is read only.
+ * Host sends function 0x41 to address 0, all boards latch their inputs together.
+ * Latched inputs are input register 8, latch time is 9..10 and the delay after the request is 11.
+ */
+
+volatile uint8_t isSampleRequested = 0;
+
+void sampleNow() {
+  // Called from otd_ModbusPoll(), keep it short
+  isSampleRequested = 1;
+}
+
+void setup() {
+  // Call this function even to reset the MCUSR
+  getLastResetCause();
+  
+  // Initialize core peripherals
+  otd_InitCorePeri();
+
+  // Initialize I/O
+  otd_InitDigitalIO();
+  otd_OutputEnable();
+  otd_InitAnalog();
+
+  // Transceiver is enabled only while sending
+  otd_UartSetDirPin(&PORTD, 3);
+
+  // Take the node ID, a new board answers to 1
+  int16_t nodeId = otd_NodeIdLoad();
+  if (nodeId < 0){
+    nodeId = 1;
+  }
+
+  // Initialize Modbus slave, frames for other boards are dropped by the UART
+  otd_InitModbus(nodeId);
+  otd_ModbusSetSampleHook(sampleNow);
+  // Host must not switch the transceiver
+  otd_ModbusSetCoilMask(~(1 << DIGITAL_OUTPUT_6));
+}
+
+void loop() {
+
+  // Configure analog for the load cell
+  otd_SetAnalogType(OTD_ANALOG_VOLTAGE);
+  otd_SetAnalogChannel(OTD_ANALOG_DIFF_1);
+  otd_SetAnalogDataRate(OTD_ANALOG_DATARATE_15Hz);
+  otd_SetAnalogGain(OTD_ANALOG_GAIN_128);
+
+  // Infinite loop
+  while(1){
+    // Answer the requests, call it as often as possible
+    otd_ModbusPoll();
+
+    // Next analog value after "sample now" is given to the host
+    if (isSampleRequested == 1 && otd_IsAnalogDataReady() == 1){
+      otd_ModbusUpdateAnalog(otd_AnalogRead());
+      isSampleRequested = 0;
+    }
+  }
+  
+}
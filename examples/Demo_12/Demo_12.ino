@@ -0,0 +1,52 @@
+#include "otd_CorePeri.h"
+#include "otd_DigitalIO.h"
+#include "otd_I2c.h"
+#include "otd_Format.h"
+#include <util/delay.h>
+
+/*
+ * Benchmark of the digital input read for each I2C speed profile.
+ * Prints the time of 1000 reads and the reads per second.
+ * FAST and FAST_PLUS give wrong inputs if the expander or the pull ups are not fast enough,
+ * so the last value is printed as well. BASELINE is the timing before the speed profiles, the one to compare with.
+ * Background refresh of the inputs is stopped, its transfers would be counted in the reads.
+ */
+
+const char *speedName[OTD_I2C_SPEED_COUNT] = {"STANDARD", "FAST", "FAST_PLUS", "BASELINE"};
+
+void setup() {
+  // Call this function even to reset the MCUSR
+  getLastResetCause();
+  
+  // Initialize core peripherals
+  otd_InitCorePeri();
+
+  // Initialize I/O
+  otd_InitDigitalIO();
+  otd_DigitalSetRefresh(0);
+}
+
+void loop() {
+
+  const unsigned int readCount = 1000;
+  uint8_t inputs = 0;
+
+  for (uint8_t speed = 0; speed < OTD_I2C_SPEED_COUNT; speed++){
+    otd_I2cSetSpeed((enum OTD_I2C_SPEED)speed);
+
+    unsigned long startTS = getUptime_us();
+    for (unsigned int i = 0; i < readCount; i++){
+      inputs = otd_DigitalReadAll();
+    }
+    unsigned long elapsed = getUptime_us() - startTS;
+
+    otd_UartPrintf("%s: %lu us, %lu reads/s, inputs=%b\n", speedName[speed], elapsed,
+                   (1000000UL * readCount) / elapsed, inputs);
+  }
+
+  // Back to the default
+  otd_I2cSetSpeed(OTD_I2C_SPEED_DEFAULT);
+
+  // Repeat every 5 seconds
+  _delay_ms(5000);
+}
@@ -0,0 +1,48 @@
+#include "otd_CorePeri.h"
+#include "otd_DigitalIO.h"
+#include "otd_Format.h"
+
+/*
+ * Same inputs as Demo_3 without sampling delays.
+ * The button on DIGITAL_INPUT_1 is debounced for 20ms and the switch on DIGITAL_INPUT_7 for 50ms.
+ * Every press toggles DIGITAL_OUTPUT_6 while the switch is on, and each edge is printed with its time.
+ */
+
+void setup() {
+  // Call this function even to reset the MCUSR
+  getLastResetCause();
+  
+  // Initialize core peripherals
+  otd_InitCorePeri();
+
+  // Initialize digital IO
+  otd_InitDigitalIO();
+  otd_DigitalSetDebounce(DIGITAL_INPUT_1, 20);
+  otd_DigitalSetDebounce(DIGITAL_INPUT_7, 50);
+}
+
+void loop() {
+
+  struct OTD_DIGIN_EVENT event;
+
+  // Enable digital output
+  otd_OutputEnable();
+
+  // Enter infinite loop
+  while(1){
+    // Handle every edge since the last loop
+    while (otd_DigitalGetEvent(&event) == 0){
+      otd_UartPrintf("%lu ms: input %u %s\n", event.time_ms, event.pin + 1, event.isRising ? "on" : "off");
+
+      if (event.pin == DIGITAL_INPUT_1 && event.isRising == 1){
+        // Toggle the LED on every press, when the switch is on
+        if (otd_DigitalReadDebounced() & (1 << DIGITAL_INPUT_7)){
+          otd_DigitalWrite(DIGITAL_OUTPUT_6, !otd_GetDigitalWriteState(DIGITAL_OUTPUT_6));
+        }
+      }else if (event.pin == DIGITAL_INPUT_7 && event.isRising == 0){
+        // Switch off turns the LED off
+        otd_DigitalWrite(DIGITAL_OUTPUT_6, 0);
+      }
+    }
+  }
+}
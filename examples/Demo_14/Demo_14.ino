@@ -0,0 +1,43 @@
+#include "otd_CorePeri.h"
+#include "otd_DigitalIO.h"
+#include "otd_Format.h"
+#include <util/delay.h>
+
+/*
+ * 32 digital inputs: the on-board 8, a PCF8575 at address 0x21 and a PCF8574 at 0x22.
+ * The extra expanders are on the same SCL/SDA lines. All are scanned in the background every 20ms.
+ * Prints the input word, the input 9 and the scan time once a second.
+ */
+
+const struct OTD_DIGIN_DEVICE wideExpander = {0x21, 2, 0};
+const struct OTD_DIGIN_DEVICE smallExpander = {0x22, 1, 0};
+
+void setup() {
+  // Call this function even to reset the MCUSR
+  getLastResetCause();
+  
+  // Initialize core peripherals
+  otd_InitCorePeri();
+
+  // Initialize digital IO, inputs of the expanders start at 8 and 24
+  otd_InitDigitalIO();
+  otd_DigitalAddDevice(&wideExpander);
+  otd_DigitalAddDevice(&smallExpander);
+  otd_DigitalSetRefresh(20);
+}
+
+void loop() {
+
+  struct OTD_DIGIN_SCAN_STATS stats;
+  uint32_t scanTime_ms;
+
+  uint32_t inputs = otd_DigitalReadWide(&scanTime_ms);
+  otd_DigitalGetScanStats(&stats);
+
+  otd_UartPrintf("inputs=%08lX in9=%u at %lums\n", inputs, otd_DigitalReadInput(9), scanTime_ms);
+  otd_UartPrintf("scans=%lu fail=%u status=%d last=%luus max=%luus\n", stats.scanCount, stats.failCount,
+                 stats.lastStatus, stats.last_us, stats.max_us);
+
+  // Repeat every second
+  _delay_ms(1000);
+}
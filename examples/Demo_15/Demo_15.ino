@@ -0,0 +1,49 @@
+#include "otd_CorePeri.h"
+#include "otd_DigitalIO.h"
+#include "otd_Format.h"
+
+/*
+ * Outputs are timed in the background, the loop only handles the inputs.
+ * A heater on DIGITAL_OUTPUT_1 runs at 25% of a 2 second period, the switch on DIGITAL_INPUT_7 makes it 75%.
+ * The LED on DIGITAL_OUTPUT_6 blinks 3 times at start, then slowly while the switch is on.
+ * Every press of the button on DIGITAL_INPUT_1 gives a 500ms pulse on DIGITAL_OUTPUT_2.
+ */
+
+void setup() {
+  // Call this function even to reset the MCUSR
+  getLastResetCause();
+  
+  // Initialize core peripherals
+  otd_InitCorePeri();
+
+  // Initialize digital IO
+  otd_InitDigitalIO();
+  otd_DigitalSetPwm(DIGITAL_OUTPUT_1, 2000, 250);
+  otd_DigitalBlink(DIGITAL_OUTPUT_6, 100, 100, 3);
+}
+
+void loop() {
+
+  struct OTD_DIGIN_EVENT event;
+
+  // Enable digital output
+  otd_OutputEnable();
+
+  // Enter infinite loop
+  while(1){
+    while (otd_DigitalGetEvent(&event) == 0){
+      if (event.pin == DIGITAL_INPUT_1 && event.isRising == 1){
+        otd_DigitalPulse(DIGITAL_OUTPUT_2, 500);
+      }else if (event.pin == DIGITAL_INPUT_7){
+        if (event.isRising == 1){
+          otd_DigitalSetPwm(DIGITAL_OUTPUT_1, 2000, 750);
+          otd_DigitalBlink(DIGITAL_OUTPUT_6, 500, 500, 0);
+        }else{
+          otd_DigitalSetPwm(DIGITAL_OUTPUT_1, 2000, 250);
+          otd_DigitalWrite(DIGITAL_OUTPUT_6, 0);
+        }
+        otd_UartPrintf("%lu ms: heater %s\n", event.time_ms, event.isRising ? "75%" : "25%");
+      }
+    }
+  }
+}
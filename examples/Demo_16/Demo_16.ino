@@ -0,0 +1,110 @@
+#include "otd_CorePeri.h"
+#include "otd_Format.h"
+#include <stdlib.h>
+#include <util/delay.h>
+#include <avr/interrupt.h>
+
+/*
+ * Benchmark of the otd_Format conversions against itoa(), ltoa(), ultoa() and dtostrf() of avr-libc.
+ * Prints the cycles of each conversion, the fastest of 8 runs less the call overhead.
+ * Each run is timed with interrupts masked so that the tick interrupt is not counted. dtostrf() may
+ * hold off a tick for longer than a tick period, uptime can fall behind while this demo runs.
+ *
+ * Flash: set BENCH_MODE to 1 and to 2, and compare the program sizes the IDE prints. Mode 1 links
+ * only otd_Format, mode 2 only the avr-libc conversions and the float library. otd_Format is part of
+ * the library core either way (otd_UartPrintf), so mode 2 shows the cost of adding avr-libc on top.
+ *
+ * Results: none are recorded yet, the cycle counts and program sizes have not been measured on a
+ * board. Until they are, "faster" and "smaller" are expectations from the method (no divide, no
+ * float library), not figures. Record the printed table and the sizes of both modes here, with the
+ * library commit and the compiler version.
+ */
+// 0: both, 1: otd_Format only, 2: avr-libc only
+#define BENCH_MODE    0
+
+struct bench {
+  const char *name;
+  void (*run)(void);
+};
+
+char text[OTD_FORMAT_FIELD_MAX];
+volatile int intValue = -12345;
+volatile long longValue = -1234567890L;
+volatile unsigned long hexValue = 0xDEADBEEFUL;
+volatile long fixedValue = 1234567L;      // 1.234567 scaled by 10^6
+volatile double floatValue = 1.234567;
+
+void runEmpty() {}
+#if BENCH_MODE != 2
+void runFormatInt16() { otd_FormatInt(text, intValue); }
+void runFormatInt32() { otd_FormatInt(text, longValue); }
+void runFormatHex() { otd_FormatHex(text, hexValue, 8); }
+void runFormatFixed() { otd_FormatFixed(text, fixedValue, 6); }
+#endif
+#if BENCH_MODE != 1
+void runItoa() { itoa(intValue, text, 10); }
+void runLtoa() { ltoa(longValue, text, 10); }
+void runUltoa() { ultoa(hexValue, text, 16); }
+void runDtostrf() { dtostrf(floatValue, 0, 6, text); }
+#endif
+
+const struct bench benchList[] = {
+#if BENCH_MODE != 2
+  {"otd_FormatInt  16", runFormatInt16},
+  {"otd_FormatInt  32", runFormatInt32},
+  {"otd_FormatHex  32", runFormatHex},
+  {"otd_FormatFixed  ", runFormatFixed},
+#endif
+#if BENCH_MODE != 1
+  {"itoa           16", runItoa},
+  {"ltoa           32", runLtoa},
+  {"ultoa hex      32", runUltoa},
+  {"dtostrf          ", runDtostrf},
+#endif
+};
+const uint8_t benchCount = sizeof(benchList) / sizeof(struct bench);
+
+// Fastest of 8 runs, cycles of the free running Timer/Counter1
+uint16_t measure(void (*run)(void)) {
+
+  uint16_t best = 0xFFFF;
+
+  for (uint8_t i = 0; i < 8; i++){
+    uint8_t oldSREG = SREG;
+    cli();
+    uint16_t startCycles = otd_GetCycleCount();
+    run();
+    uint16_t cycles = otd_GetCycleCount() - startCycles;
+    SREG = oldSREG;
+    if (cycles < best){
+      best = cycles;
+    }
+  }
+  return best;
+}
+
+void setup() {
+  // Call this function even to reset the MCUSR
+  getLastResetCause();
+  
+  // Initialize core peripherals
+  otd_InitCorePeri();
+}
+
+void loop() {
+
+  uint16_t overhead = measure(runEmpty);
+
+  otd_UartPrintf("%u cycles call overhead, subtracted\n", overhead);
+  for (uint8_t i = 0; i < benchCount; i++){
+    // Masked runs would stop the transmitter, let the line out first
+    otd_UartFlush();
+    uint16_t cycles = measure(benchList[i].run) - overhead;
+    benchList[i].run();
+    otd_UartPrintf("%s: %5u cycles, %3u us \"%s\"\n", benchList[i].name, cycles, cycles / (F_CPU / 1000000UL), text);
+  }
+  otd_UartPrintf("\n");
+
+  // Repeat every 5 seconds
+  _delay_ms(5000);
+}
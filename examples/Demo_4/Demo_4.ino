@@ -1,7 +1,7 @@
-#include <util/delay.h>
 #include "otd_CorePeri.h"
 #include "otd_DigitalIO.h"
 #include "otd_Pulse.h"
+#include "otd_Timer.h"
 
 enum MOTOR_STATE{
   MOTOR_STOP = 0,
@@ -27,6 +27,9 @@ void setup() {
 
   // Initialize Pulse
   otd_InitPulse();
+
+  // Initialize software timers
+  otd_InitTimer();
   
 }
 
@@ -37,6 +40,8 @@ void loop() {
   //
   const unsigned int motorCheckDiff = 50; // Switch status is checked every 250ms
   enum MOTOR_STATE curMotorState = MOTOR_STOP;
+  // One-shot timer to let the motor settle on direction change
+  int8_t dirTimerId = otd_TimerCreate(0);
 
   // Enable digital output
   otd_OutputEnable();
@@ -59,8 +64,8 @@ void loop() {
      */
     // Is LED update time
     if (currentTS-motorLastTS > motorCheckDiff){
-      // Check whether pulse stoped
-      if(otd_GetPulseEnabled(PULSE_OUTPUT_1) == 0){
+      // Check whether pulse stoped and direction change wait is over
+      if(otd_GetPulseEnabled(PULSE_OUTPUT_1) == 0 && otd_TimerIsActive(dirTimerId) == 0){
         // Move to next motor state
         switch(curMotorState){
         case MOTOR_STOP:
@@ -87,8 +92,8 @@ void loop() {
         case MOTOR_SLOW_DOWN_FRWD:
           // Set Motor direction backward
           otd_DigitalWrite(DIGITAL_OUTPUT_2, 0);
-          // Wait 250 ms
-          _delay_ms(250);
+          // Wait 250 ms without blocking
+          otd_TimerStart(dirTimerId, 250, 0);
           curMotorState = MOTOR_STOP_CHG_DIR;
           break;
 
@@ -116,7 +121,7 @@ void loop() {
         case MOTOR_SLOW_DOWN_BACK:
           // Set Motor direction forward
           otd_DigitalWrite(DIGITAL_OUTPUT_2, 1);
-          _delay_ms(250); // Wait 250 ms
+          otd_TimerStart(dirTimerId, 250, 0); // Wait 250 ms without blocking
           curMotorState = MOTOR_STOP;
           break;
         }
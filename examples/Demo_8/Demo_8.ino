@@ -0,0 +1,89 @@
+#include "otd_CorePeri.h"
+#include "otd_DigitalIO.h"
+#include "otd_Scheduler.h"
+
+uint8_t switchState = 0;
+uint8_t buttonState = 0;
+int8_t ledTaskId = -1;
+
+
+// Switch status is checked every 250ms
+void switchTask() {
+  switchState = otd_DigitalRead(DIGITAL_INPUT_7);
+}
+
+// Button status is checked every 50ms
+void buttonTask() {
+  buttonState = otd_DigitalRead(DIGITAL_INPUT_1);
+}
+
+// LED is updated every 100ms
+void ledTask() {
+  // Check whether switch is on
+  if (switchState == 1){
+    // Check whether button is pressed
+    if(buttonState == 1){
+      // Turn on the led
+      otd_DigitalWrite(DIGITAL_OUTPUT_6, 1);
+    }else{
+      // Blink the led
+      otd_DigitalWrite(DIGITAL_OUTPUT_6, !otd_GetDigitalWriteState(DIGITAL_OUTPUT_6));
+    }
+  }else{
+    // Turn off the led
+    otd_DigitalWrite(DIGITAL_OUTPUT_6, 0);
+  }
+}
+
+// Task timing is reported every 5s
+void reportTask() {
+  struct OTD_SCHED_STATS stats;
+
+  otd_SchedGetStats(ledTaskId, &stats);
+  otd_UartPrint("> LED task runs: ");
+  otd_UartPrintInt(stats.runCount);
+  otd_UartPrint("  jitter us: ");
+  otd_UartPrintInt(stats.maxJitter_us);
+  otd_UartPrint("  exec us: ");
+  otd_UartPrintInt(stats.maxExec_us);
+  otd_UartPrint("  overruns: ");
+  otd_UartPrintInt(stats.overrunCount);
+  otd_UartPrint("  CPU load x0.1%: ");
+  otd_UartPrintInt(otd_GetCpuLoad());
+  otd_UartPrintln("");
+}
+
+
+void setup() {
+  // Call this function even to reset the MCUSR
+  getLastResetCause();
+  
+  // Initialize core peripherals
+  otd_InitCorePeri();
+
+  // Initialize digital IO
+  otd_InitDigitalIO();
+
+  // Initialize scheduler
+  otd_InitScheduler();
+
+  // Add tasks: function, period ms, phase ms, priority (lower runs first)
+  otd_SchedAddTask(buttonTask, 50, 0, 0);
+  otd_SchedAddTask(switchTask, 250, 10, 1);
+  ledTaskId = otd_SchedAddTask(ledTask, 100, 20, 2);
+  otd_SchedAddTask(reportTask, 5000, 30, 3);
+}
+
+void loop() {
+
+  // Enable digital output
+  otd_OutputEnable();
+
+  // Enter infinite loop
+  while(1){
+    // Run the released tasks, sleep until the next interrupt when there is nothing to do
+    if (otd_SchedRun() == 0){
+      otd_Idle();
+    }
+  }
+}
@@ -0,0 +1,75 @@
+#include "otd_CorePeri.h"
+#include "otd_DigitalIO.h"
+#include "otd_Analog.h"
+#include "otd_Telemetry.h"
+
+/*
+ * Streams the load cell and the digital inputs as binary telemetry frames.
+ * Decode them on the PC with "extras/otd_telemetry.py".
+ */
+
+void setup() {
+  // Call this function even to reset the MCUSR
+  getLastResetCause();
+  
+  // Initialize core peripherals
+  otd_InitCorePeri();
+
+  // Initialize digital I/O and analog interface
+  otd_InitDigitalIO();
+  otd_InitAnalog();
+
+  // Initialize telemetry, sequence starts from 0
+  otd_InitTelemetry();
+}
+
+void loop() {
+
+  unsigned long sensorReadLastTS = 0;     // Time stamp for last sensor read in ms
+  unsigned long digitalLastTS = 0;        // Time stamp for last digital snapshot in ms
+  unsigned long currentTS;                // Current time stamp in ms
+  //
+  const unsigned int sensorCheckDiff = 10;    // Analog data is checked every 10ms
+  const unsigned int digitalSendDiff = 100;   // Digital snapshot is sent every 100ms
+
+
+  // Configure analog type
+  otd_SetAnalogType(OTD_ANALOG_VOLTAGE);
+  // Configure analog channel
+  otd_SetAnalogChannel(OTD_ANALOG_DIFF_1);
+  // Set data rate to 30Hz
+  otd_SetAnalogDataRate(OTD_ANALOG_DATARATE_30Hz);
+  // Set gain to 128
+  otd_SetAnalogGain(OTD_ANALOG_GAIN_128);
+
+  union OTD_ANALOG_VALUE anaValue;
+
+  // Infinite loop
+  while(1){
+    // Get current time stamp
+    currentTS = getUptime_ms();
+
+    // Load cell task
+    if (currentTS-sensorReadLastTS > sensorCheckDiff){
+      if (otd_IsAnalogDataReady() == 1){
+        anaValue = otd_AnalogRead();
+        // 14 bytes on the line (12 byte frame, COBS overhead and delimiter) instead of ~30 characters
+        otd_TlmSendAnalog(OTD_ANALOG_DIFF_1, OTD_ANALOG_VOLTAGE, (int32_t)(anaValue.voltage_V*1000000));
+      }
+      sensorReadLastTS = currentTS;
+    }
+
+    // Digital snapshot task
+    if (currentTS-digitalLastTS > digitalSendDiff){
+      uint8_t outputs = 0;
+      for (uint8_t i = 0; i < 6; i++){
+        if (otd_GetDigitalWriteState((enum DIGITAL_OUTPUT_PINS)i)){
+          outputs |= (1 << i);
+        }
+      }
+      otd_TlmSendDigital(otd_DigitalReadAll(), outputs);
+      digitalLastTS = currentTS;
+    }
+  }
+  
+}
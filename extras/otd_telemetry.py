@@ -0,0 +1,116 @@
+#!/usr/bin/env python3
+"""Decoder for the OtD Library binary telemetry (otd_Telemetry).
+
+Frames are COBS encoded and end with 0x00. After decoding:
+    [seq u8][record type u8][time ms u16][payload ...][CRC-16/CCITT-FALSE u16]
+Multi-byte fields are little endian. See src/otd_Telemetry.h.
+
+Usage:
+    python3 otd_telemetry.py /dev/ttyUSB0 [baud]    (needs pyserial)
+    python3 otd_telemetry.py capture.bin
+"""
+
+import struct
+import sys
+
+REC_ANALOG = 1
+REC_DIGITAL = 2
+REC_PULSE = 3
+
+ANALOG_TYPE = {0: ("voltage", "uV"), 1: ("current", "uA")}
+
+
+def crc16_ccitt_false(data):
+    crc = 0xFFFF
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else (crc << 1)
+            crc &= 0xFFFF
+    return crc
+
+
+def cobs_decode(data):
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        code = data[i]
+        if code == 0 or i + code > len(data):
+            raise ValueError("bad COBS code")
+        out += data[i + 1:i + code]
+        i += code
+        if code < 0xFF and i < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+def decode_frame(encoded):
+    """Returns (seq, record type, time ms, payload) or raises ValueError."""
+    frame = cobs_decode(encoded)
+    if len(frame) < 6:
+        raise ValueError("short frame")
+    (crc,) = struct.unpack_from("<H", frame, len(frame) - 2)
+    if crc16_ccitt_false(frame[:-2]) != crc:
+        raise ValueError("CRC mismatch")
+    seq, rec_type, time_ms = struct.unpack_from("<BBH", frame, 0)
+    return seq, rec_type, time_ms, frame[4:-2]
+
+
+def format_record(rec_type, payload):
+    if rec_type == REC_ANALOG and len(payload) == 6:
+        channel, kind, value = struct.unpack("<BBi", payload)
+        name, unit = ANALOG_TYPE.get(kind, ("type%d" % kind, ""))
+        return "ANALOG ch=%d %s=%d %s" % (channel, name, value, unit)
+    if rec_type == REC_DIGITAL and len(payload) == 2:
+        inputs, outputs = struct.unpack("<BB", payload)
+        return "DIGITAL in=%s out=%s" % (format(inputs, "08b"), format(outputs, "06b"))
+    if rec_type == REC_PULSE and len(payload) == 6:
+        pin, freq, duty, count = struct.unpack("<BHBH", payload)
+        return "PULSE pin=%d freq=%dHz duty=%d/256 count=%d" % (pin, freq, duty, count)
+    return "REC 0x%02X %s" % (rec_type, payload.hex())
+
+
+def frames(stream):
+    """Yields the encoded frames between 0x00 delimiters."""
+    buf = bytearray()
+    while True:
+        chunk = stream.read(64)
+        if not chunk:
+            return
+        for byte in chunk:
+            if byte == 0:
+                if buf:
+                    yield bytes(buf)
+                buf.clear()
+            else:
+                buf.append(byte)
+
+
+def main(argv):
+    if len(argv) < 2:
+        print(__doc__)
+        return 1
+    if argv[1].startswith("/dev/") or argv[1].upper().startswith("COM"):
+        import serial
+        stream = serial.Serial(argv[1], int(argv[2]) if len(argv) > 2 else 19200, timeout=1)
+    else:
+        stream = open(argv[1], "rb")
+
+    last_seq = None
+    errors = 0
+    for encoded in frames(stream):
+        try:
+            seq, rec_type, time_ms, payload = decode_frame(encoded)
+        except ValueError as exc:
+            errors += 1
+            print("# dropped frame (%s), %d so far" % (exc, errors))
+            continue
+        if last_seq is not None and seq != (last_seq + 1) & 0xFF:
+            print("# %d frame(s) lost" % ((seq - last_seq - 1) & 0xFF))
+        last_seq = seq
+        print("%3d %5d ms  %s" % (seq, time_ms, format_record(rec_type, payload)))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
@@ -0,0 +1,161 @@
+#!/usr/bin/env python3
+"""Host check of the software UART receive timing (otd_CorePeri).
+
+Reads the rate table and the latency constants from the library sources, then
+works out where each receive sample falls inside its bit for the worst case of:
+    - the bit period rounding of every rate (UART_BIT_CYCLES)
+    - the clock difference between the two sides (--clock-ppm)
+    - an error of the start latency estimate, UART_RX_START_LATENCY (--start-error)
+    - an error of the reload latency estimate, TCNT1_RELOAD_LATENCY, which adds up bit by bit (--reload-error)
+
+A sample is delayed by any interrupt routine or masked section which is running
+when the bit timer overflows, and so is the timer start on the start bit edge.
+"budget" is the longest such delay one rate tolerates, counting both. Pass the
+measured one with --load, e.g. the largest of the ISR and CLI maxima printed by
+otd_ProfileDump() with OTD_PROFILE_ENABLE set to 1.
+
+Rates above UART_RX_MAX_BAUD are transmit only. For them the edges sent on the
+bit timer overflows are checked against a receiver which finds the start edge
+with 16x oversampling and samples at the bit middle. All edges come from the
+overflow interrupt, so only the delay of one edge counts. "budget" is that delay.
+
+Exits with 1 if a listed rate does not fit.
+
+Usage:
+    python3 otd_uart_timing.py [--load cycles] [--clock-ppm ppm] [--rate baud ...] [--rx]
+"""
+
+import argparse
+import os
+import re
+import sys
+
+SRC_DIR = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "src")
+DATA_BITS = 8
+
+
+def read_source(name):
+    with open(os.path.join(SRC_DIR, name)) as src:
+        return src.read()
+
+
+def define(text, name):
+    match = re.search(r"^#define\s+%s\s+(\d+)" % name, text, re.M)
+    if match is None:
+        raise SystemExit("%s not found in the sources" % name)
+    return int(match.group(1))
+
+
+def bit_cycles(f_cpu, baud):
+    # Same rounding as UART_BIT_CYCLES()
+    return (f_cpu + baud // 2) // baud
+
+
+def check_rate(f_cpu, baud, const, args):
+    cycles = bit_cycles(f_cpu, baud)
+    quant_ppm = (f_cpu - cycles * baud) * 1000000.0 / (cycles * baud)
+    # Sender bit period in receiver cycles
+    sender_min = f_cpu / baud * (1 - args.clock_ppm / 1e6)
+    sender_max = f_cpu / baud * (1 + args.clock_ppm / 1e6)
+
+    # Sample k reads data bit k, the last one reads the stop bit. Counted from the start bit edge:
+    # timer starts UART_RX_START_LATENCY after the edge, first overflow 1.5 bit minus that later,
+    # then one every "cycles". Reload latency errors add up, the start latency error is counted once
+    early = late = None
+    for k in range(DATA_BITS + 1):
+        nominal = 1.5 * cycles + k * cycles
+        spread = args.start_error + k * args.reload_error
+        early_k = (nominal - spread) - (k + 1) * sender_max
+        late_k = (k + 2) * sender_min - (nominal + spread)
+        early = early_k if early is None else min(early, early_k)
+        late = late_k if late is None else min(late, late_k)
+
+    # Start and one sample can both be held off. An overflow held off longer than this is clamped
+    # by otd_CycleTimerReload() and the rest of the byte slips
+    budget = min(late / 2, cycles - const["TCNT1_RELOAD_MIN"] - const["TCNT1_RELOAD_LATENCY"])
+    problems = []
+    if cycles < const["UART_MIN_BIT_CYCLES"]:
+        problems.append("below UART_MIN_BIT_CYCLES")
+    if abs(quant_ppm) > const["UART_BAUD_TOLERANCE_PPM"]:
+        problems.append("rounding error out of tolerance")
+    if const["UART_RX_START_LATENCY"] >= cycles + cycles // 2 - const["TCNT1_RELOAD_MIN"]:
+        problems.append("start latency longer than the first half bit")
+    if early < 0:
+        problems.append("samples before the bit")
+    if budget < args.load:
+        problems.append("budget below the load")
+
+    print("%6d  %4d  %+6d  %6.1f  %6.1f  %6.1f  %s" % (baud, cycles, round(quant_ppm), early, late, budget,
+                                                   ", ".join(problems) if problems else "ok"))
+    return not problems
+
+
+def check_tx_rate(f_cpu, baud, const, args):
+    cycles = bit_cycles(f_cpu, baud)
+    quant_ppm = (f_cpu - cycles * baud) * 1000000.0 / (cycles * baud)
+    # Receiver bit period in sender cycles, and how late it may see the start edge
+    receiver_min = f_cpu / baud * (1 - args.clock_ppm / 1e6)
+    receiver_max = f_cpu / baud * (1 + args.clock_ppm / 1e6)
+    detect = f_cpu / baud / 16
+
+    # Bit k of the frame (start bit is 0, stop bit is 9) is sent from k * cycles to (k + 1) * cycles,
+    # its start edge may be held off. Receiver samples it (k + 0.5) of its bits after the start edge
+    early = late = None
+    for k in range(1, DATA_BITS + 2):
+        early_k = (k + 0.5) * receiver_min - k * cycles
+        late_k = (k + 1) * cycles - ((k + 0.5) * receiver_max + detect)
+        early = early_k if early is None else min(early, early_k)
+        late = late_k if late is None else min(late, late_k)
+
+    # A held off edge shortens the bit before and delays the bit, the receiver must not sample before it
+    budget = min(early, cycles - const["TCNT1_RELOAD_MIN"] - const["TCNT1_RELOAD_LATENCY"])
+    problems = []
+    if cycles < const["UART_MIN_BIT_CYCLES"]:
+        problems.append("below UART_MIN_BIT_CYCLES")
+    if abs(quant_ppm) > const["UART_BAUD_TOLERANCE_PPM"]:
+        problems.append("rounding error out of tolerance")
+    if late < 0:
+        problems.append("samples after the bit")
+    if budget < args.load:
+        problems.append("budget below the load")
+
+    print("%6d  %4d  %+6d  %6.1f  %6.1f  %6.1f  %s" % (baud, cycles, round(quant_ppm), early, late, budget,
+                                                   ", ".join(problems) if problems else "ok, transmit only"))
+    return not problems
+
+
+def main(argv):
+    parser = argparse.ArgumentParser(description="Software UART receive timing check")
+    parser.add_argument("--f-cpu", type=int, default=8000000)
+    parser.add_argument("--load", type=float, default=0, help="longest interrupt or masked section, cycles")
+    parser.add_argument("--clock-ppm", type=float, default=10000, help="clock difference between the sides")
+    parser.add_argument("--start-error", type=float, default=8, help="start latency estimate error, cycles")
+    parser.add_argument("--reload-error", type=float, default=2, help="reload latency estimate error, cycles")
+    parser.add_argument("--rate", type=int, action="append", help="check this rate instead of the table")
+    parser.add_argument("--rx", action="store_true", help="check the transmit only rates for receiving too")
+    args = parser.parse_args(argv[1:])
+
+    core = read_source("otd_CorePeri.cpp")
+    timebase = read_source("otd_Timebase.cpp")
+    const = {}
+    for name in ("UART_RX_START_LATENCY", "UART_MIN_BIT_CYCLES", "UART_BAUD_TOLERANCE_PPM", "UART_RX_MAX_BAUD"):
+        const[name] = define(core, name)
+    for name in ("TCNT1_RELOAD_LATENCY", "TCNT1_RELOAD_MIN"):
+        const[name] = define(timebase, name)
+    table = [int(baud) for baud in re.findall(r"\{(\d+),\s*UART_BIT_CYCLES", core)]
+    rates = args.rate if args.rate else table
+
+    print("# F_CPU=%d start latency=%d reload latency=%d load=%g cycles" % (args.f_cpu,
+          const["UART_RX_START_LATENCY"], const["TCNT1_RELOAD_LATENCY"], args.load))
+    print("#  baud  bit   ppm     early   late    budget")
+    passed = True
+    for baud in rates:
+        if baud > const["UART_RX_MAX_BAUD"] and not args.rx:
+            passed = check_tx_rate(args.f_cpu, baud, const, args) and passed
+        else:
+            passed = check_rate(args.f_cpu, baud, const, args) and passed
+    return 0 if passed else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
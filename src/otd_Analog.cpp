@@ -23,14 +23,36 @@ extern "C"{
 #endif 
 
 #include <avr/io.h>
+#include <avr/pgmspace.h>
 #include <util/delay.h>
 #include <string.h>
 
+#include "otd_Timebase.h"
+#include "otd_Memory.h"
+
 static enum OTD_ANALOG_TYPE sAnalogType = OTD_ANALOG_TYPE_NOT_SET;
 static enum OTD_ANALOG_CHANNEL sAnalogChannel = OTD_ANALOG_CHAN_NOT_SET;
 static enum OTD_ANALOG_DATARATE sAnalogDataRate = OTD_ANALOG_DATARATE_15Hz;
 static enum OTD_ANALOG_GAIN sAnalogGain = OTD_ANALOG_GAIN_1;
 static float sAnalogGainValue = 1;
+//
+static uint8_t sIsStreaming = 0;
+static uint32_t sStreamRef_us = 0;		// Assumed end of the last conversion read
+static uint32_t sStreamPeriod_us = 0;
+static uint8_t sStreamSettle = 0;
+static uint16_t sStreamMissCount = 0;
+static uint16_t sStreamSyncCount = 0;		// Conversions since the last sync
+static uint32_t sStreamData = 0;			// Last good conversion
+static int8_t sStreamStatus = 0;			// Result of the last sync
+static uint8_t sStreamResync = 0;			// Continuous read is stopped, conversions are taken by the ready flag
+static uint8_t sStreamIsReady = 0;			// Ready flag was seen while resyncing, the conversion is not read yet
+static uint32_t sStreamPoll_us = 0;		// Last ready flag read while resyncing
+static uint32_t sStreamEnd_us = 0;			// Estimated end of the conversion seen ready
+// Reported by otd_Memory
+const uint16_t otd_RamUsage_Analog = sizeof(sIsStreaming) + sizeof(sStreamRef_us) + sizeof(sStreamPeriod_us) +
+										sizeof(sStreamSettle) + sizeof(sStreamMissCount) + sizeof(sStreamSyncCount) +
+										sizeof(sStreamData) + sizeof(sStreamStatus) + sizeof(sStreamResync) +
+										sizeof(sStreamIsReady) + sizeof(sStreamPoll_us) + sizeof(sStreamEnd_us);
 
 
 
@@ -89,6 +111,17 @@ static const float sOscPeriod_uS = (1000.0 * 1000.0) /OSC_FREQ_HZ;
 #define ANALOG_VADC_OFFSET		2.25
 #define ANALOG_IF_SCALE			4.444444444
 #define ANALOG_VIN_OFFSET		10
+// Conversion period of each data rate
+static const uint32_t sDataPeriod_us[4] PROGMEM = {33333, 66667, 133333, 266667};
+// Streamed reads keep 1/8 of the period away from the end of a conversion
+#define STREAM_MARGIN_DIV		8
+// A resync takes the conversion end between two ready flag reads at most 1/32 of the period apart
+#define STREAM_SYNC_DIV			32
+// Drift grows by "period * ppm" each conversion, so the count does not depend on the data rate.
+// Half of the sync window is a timing error, it is taken from the margin
+#define STREAM_RESYNC_COUNT		((1000000UL * (2 * STREAM_SYNC_DIV - STREAM_MARGIN_DIV)) \
+									/ (2UL * STREAM_SYNC_DIV * STREAM_MARGIN_DIV * (uint32_t)OTD_ANALOG_STREAM_DRIFT_PPM))
+static_assert(STREAM_RESYNC_COUNT >= 2, "OTD_ANALOG_STREAM_DRIFT_PPM is too high to stream");
 
 
 
@@ -96,6 +129,16 @@ static void ic1242_Reset();
 static uint8_t ic1242_ReadRegister(uint8_t inRegAddr);
 static void ic1242_WriteRegister(uint8_t inRegAddr, uint8_t inRegData);
 static float ic1242_ConvertToVolt(uint32_t inData, uint8_t);
+static uint32_t ic1242_ReadData();
+static uint32_t ic1242_ShiftData();
+static uint8_t ic1242_IsReady();
+static union OTD_ANALOG_VALUE analog_convert(uint32_t inData);
+static int8_t stream_sync();
+static void stream_restart();
+static uint32_t stream_due();
+static uint8_t stream_resync_poll();
+static void stream_count_miss(uint32_t inCount);
+static int8_t stream_take();
 //
 static void initSpi();
 static uint8_t transferSpi(uint8_t inData);
@@ -108,9 +151,11 @@ void otd_InitAnalog(){
 	uint8_t tmpDataRead;
 	uint8_t tmpDataWrite;
 
-	// Release chip select
+	// Release chip select. Reset below ends a continuous read
 	PORTD |= _BV(PORTD0);
 	DDRD |= _BV(PORTD0);
+	sIsStreaming = 0;
+	sStreamResync = 0;
 
 	// Initialize SPI interface
 	initSpi();
@@ -206,6 +251,9 @@ void otd_SetAnalogChannel(enum OTD_ANALOG_CHANNEL inAnaChan){
 		return;
 	}
 
+	// Registers are written out of the continuous read
+	uint8_t wasStreaming = sIsStreaming;
+	otd_AnalogStreamStop();
 
 	/*
 	 * Just in case write multiplexer value twice
@@ -218,6 +266,9 @@ void otd_SetAnalogChannel(enum OTD_ANALOG_CHANNEL inAnaChan){
 	ic1242_WriteRegister(tmpRegAddr, tmpDataWrite);
 
 	sAnalogChannel = inAnaChan;
+	if (wasStreaming){
+		stream_restart();
+	}
 	return;
 }
 
@@ -266,6 +317,10 @@ void otd_SetAnalogDataRate(enum OTD_ANALOG_DATARATE inAnaDataRate){
 
 
 
+	// Registers are read and written out of the continuous read
+	uint8_t wasStreaming = sIsStreaming;
+	otd_AnalogStreamStop();
+
 	// Read Analog Control Register
 	tmpRegAddr = IC1242_REG_ACR;
 	tmpDataRead = ic1242_ReadRegister(tmpRegAddr);
@@ -280,6 +335,9 @@ void otd_SetAnalogDataRate(enum OTD_ANALOG_DATARATE inAnaDataRate){
 
 
 	sAnalogDataRate = inAnaDataRate;
+	if (wasStreaming){
+		stream_restart();
+	}
 
 	return;
 }
@@ -359,6 +417,10 @@ void otd_SetAnalogGain(enum OTD_ANALOG_GAIN inAnaGain){
 	}
 
 
+	// Registers are read and written out of the continuous read
+	uint8_t wasStreaming = sIsStreaming;
+	otd_AnalogStreamStop();
+
 	// Read Setup Register
 	tmpRegAddr = IC1242_REG_SETUP;
 	tmpDataRead = ic1242_ReadRegister(tmpRegAddr);
@@ -380,6 +442,9 @@ void otd_SetAnalogGain(enum OTD_ANALOG_GAIN inAnaGain){
 	ic1242_WriteRegister(tmpRegAddr, tmpDataWrite);
 
 	sAnalogGain = inAnaGain;
+	if (wasStreaming){
+		stream_restart();
+	}
 
 	return;
 }
@@ -392,50 +457,110 @@ enum OTD_ANALOG_GAIN otd_GetAnalogGain(){
 
 uint8_t otd_IsAnalogDataReady(){
 
-	uint8_t tmpRegAddr;
-	uint8_t tmpDataRead;
+	// Ready flag can not be read in the continuous read, it is timed. Conversions of the settle time are dropped here
+	if (sIsStreaming){
+		if (sStreamSettle != 0){
+			stream_take();
+			return 0;
+		}
+		return stream_due() != 0;
+	}
 
-	IC1242_CS_ENABLE;
+	return ic1242_IsReady();
+}
 
-	// Read setup register
-	tmpRegAddr = IC1242_REG_ACR;
-	tmpDataRead = ic1242_ReadRegister(tmpRegAddr);
 
-	IC1242_CS_DISABLE;
+union OTD_ANALOG_VALUE otd_AnalogRead(){
+
+	uint32_t voltData;
+
+	if (sIsStreaming){
+		// Last good conversion if there is no new one
+		stream_take();
+		voltData = sStreamData;
+	}else{
+		voltData = ic1242_ReadData();
+	}
 
-	// Data Ready bit is active low
-	uint8_t isDataReady = tmpDataRead & (1 << IC1242_REG_ACR_BIT_NDRDY);
-	isDataReady = isDataReady == 0;
-	return isDataReady;
+	return analog_convert(voltData);
 }
 
 
-union OTD_ANALOG_VALUE otd_AnalogRead(){
 
+// Returns 0 at start, -1 if the converter does not end a conversion within 2 periods
+int8_t otd_AnalogStreamStart(){
 
-	uint32_t voltData = 0;
-	uint8_t *outSeq = (uint8_t *) &voltData;
+	otd_AnalogStreamStop();
+	if (stream_sync() != 0){
+		return -1;
+	}
+	sStreamSettle = 0;
+	sStreamMissCount = 0;
 
-	// Send READ command
-	IC1242_CS_ENABLE;
-	transferSpi(IC1242_CMD_READ_DATA);
+	return 0;
+}
 
-	// Wait for data to be ready
-	_delay_us(150*sOscPeriod_uS);
 
-	// Get the register data
-	outSeq[2] = transferSpi(0);
-	outSeq[1] = transferSpi(0);
-	outSeq[0] = transferSpi(0);
 
+void otd_AnalogStreamStop(){
+
+	if (sIsStreaming == 0){
+		return;
+	}
+
+	// Continuous read is already stopped while resyncing
+	if (sStreamResync == 0){
+		transferSpi(IC1242_CMD_READ_CSTOP);
+	}
 	IC1242_CS_DISABLE;
+	sIsStreaming = 0;
+	sStreamResync = 0;
+
+	return;
+}
+
+
+
+uint8_t otd_AnalogIsStreaming(){
+	return sIsStreaming;
+}
+
+
+
+// Returns 0 and a new sample, or -1 if there is none yet. Call at least once per conversion period
+int8_t otd_AnalogStreamRead(union OTD_ANALOG_VALUE *outValue){
+
+	if (stream_take() != 0){
+		return -1;
+	}
+	*outValue = analog_convert(sStreamData);
+
+	return 0;
+}
+
+
+
+// Conversions which were not read, since the stream start
+uint16_t otd_AnalogGetStreamMissCount(){
+	return sStreamMissCount;
+}
+
+
+// 0, or -1 if the last start or sync timed out
+int8_t otd_AnalogGetStreamStatus(){
+	return sStreamStatus;
+}
+
+
+
+static union OTD_ANALOG_VALUE analog_convert(uint32_t inData){
 
 	union OTD_ANALOG_VALUE outAnalogValue;
 	memset(&outAnalogValue, 0, sizeof(outAnalogValue));
 
 
 	if (sAnalogChannel != OTD_ANALOG_DIFF_1 && sAnalogChannel !=OTD_ANALOG_DIFF_2){
-		float tmpVolt = ic1242_ConvertToVolt(voltData, 0);
+		float tmpVolt = ic1242_ConvertToVolt(inData, 0);
 		//
 		if (sAnalogType == OTD_ANALOG_VOLTAGE){
 			outAnalogValue.voltage_V = tmpVolt;
@@ -446,13 +571,197 @@ union OTD_ANALOG_VALUE otd_AnalogRead(){
 			outAnalogValue.current_mA = tmpCurrent_mA;
 		}
 	}else{
-		float tmpVolt = ic1242_ConvertToVolt(voltData, 1);
+		float tmpVolt = ic1242_ConvertToVolt(inData, 1);
 		outAnalogValue.voltage_V = tmpVolt;
 	}
 
+	return outAnalogValue;
+}
 
 
-	return outAnalogValue;
+
+/*
+ * STREAM FUNCTIONS
+ */
+// Waits for the end of a conversion and enters the continuous read, reads are timed from it
+static int8_t stream_sync(){
+
+	uint32_t tmpPeriod_us = pgm_read_dword(&sDataPeriod_us[sAnalogDataRate]);
+
+	// Reading the data clears the ready flag until the next conversion ends
+	ic1242_ReadData();
+	uint32_t startTS = getUptime_us();
+	while (ic1242_IsReady() == 0){
+		if (getUptime_us() - startTS > 2 * tmpPeriod_us){
+			sStreamStatus = -1;
+			return -1;
+		}
+	}
+	uint32_t syncTS = getUptime_us();
+
+	// Chip select stays low, the serial interface is reset when it goes high
+	IC1242_CS_ENABLE;
+	transferSpi(IC1242_CMD_READ_CONT);
+
+	sStreamPeriod_us = tmpPeriod_us;
+	sStreamRef_us = syncTS;
+	sStreamSyncCount = 0;
+	sStreamStatus = 0;
+	sStreamResync = 0;
+	sIsStreaming = 1;
+
+	return 0;
+}
+
+
+// After a setting change, the first conversions are dropped
+static void stream_restart(){
+
+	// A failure is kept in sStreamStatus
+	if (stream_sync() == 0){
+		sStreamSettle = OTD_ANALOG_STREAM_SETTLE;
+	}
+
+	return;
+}
+
+
+// Returns the number of conversions ended since the last read, 0 if none or if one is about to end
+static uint32_t stream_due(){
+
+	if (sIsStreaming == 0){
+		return 0;
+	}
+	if (sStreamResync){
+		return stream_resync_poll();
+	}
+
+	uint32_t tmpElapsed = getUptime_us() - sStreamRef_us;
+	if (tmpElapsed < sStreamPeriod_us){
+		return 0;
+	}
+	uint32_t tmpCount = tmpElapsed / sStreamPeriod_us;
+	uint32_t tmpPhase = tmpElapsed - tmpCount * sStreamPeriod_us;
+	uint32_t tmpMargin = sStreamPeriod_us / STREAM_MARGIN_DIV;
+	// Data register may be changing
+	if (tmpPhase < tmpMargin || tmpPhase > sStreamPeriod_us - tmpMargin){
+		return 0;
+	}
+
+	return tmpCount;
+}
+
+
+/*
+ * ::: NOTE :::	While resyncing the continuous read is stopped and each conversion is found by the ready flag.
+ * 				When a conversion end falls between two flag reads close enough, the continuous read is timed
+ * 				from it again. Nothing waits, a slow caller only stays longer on the flag reads.
+ * 				Returns 1 if a conversion is ready
+ */
+static uint8_t stream_resync_poll(){
+
+	if (sStreamIsReady){
+		return 1;
+	}
+
+	uint32_t tmpNow = getUptime_us();
+	uint32_t tmpGap = tmpNow - sStreamPoll_us;
+	if (ic1242_IsReady() == 0){
+		sStreamPoll_us = tmpNow;
+		if (tmpNow - sStreamRef_us > 2 * sStreamPeriod_us){
+			// Converter does not end conversions, the stream is stopped as after a failed start
+			sStreamStatus = -1;
+			sStreamResync = 0;
+			sIsStreaming = 0;
+		}
+		return 0;
+	}
+
+	// Conversion ended between the last two reads
+	uint32_t tmpEnd = tmpNow - tmpGap / 2;
+	if (tmpGap <= sStreamPeriod_us / STREAM_SYNC_DIV){
+		// Back to the continuous read. This conversion is read from there, after the margin
+		stream_count_miss((tmpEnd - sStreamRef_us + sStreamPeriod_us / 2) / sStreamPeriod_us);
+		IC1242_CS_ENABLE;
+		transferSpi(IC1242_CMD_READ_CONT);
+		sStreamRef_us = tmpEnd - sStreamPeriod_us;
+		sStreamSyncCount = 0;
+		sStreamStatus = 0;
+		sStreamResync = 0;
+		return 0;
+	}
+	// Too far apart to sync. The last end due by the period is closer, kept within the two reads
+	uint32_t tmpCount = (tmpNow - sStreamRef_us) / sStreamPeriod_us;
+	if (tmpCount == 0){
+		tmpCount = 1;
+	}
+	tmpEnd = sStreamRef_us + tmpCount * sStreamPeriod_us;
+	if ((int32_t)(tmpEnd - tmpNow) > 0){
+		tmpEnd = tmpNow;
+	}else if ((int32_t)(tmpEnd - sStreamPoll_us) < 0){
+		tmpEnd = sStreamPoll_us;
+	}
+	sStreamEnd_us = tmpEnd;
+	sStreamIsReady = 1;
+
+	return 1;
+}
+
+
+// Conversions ended since the last read, all but the last one are missed
+static void stream_count_miss(uint32_t inCount){
+
+	if (inCount > 1){
+		uint32_t tmpMissCount = sStreamMissCount + (inCount - 1);
+		sStreamMissCount = (tmpMissCount > 0xFFFF) ? 0xFFFF : tmpMissCount;
+	}
+
+	return;
+}
+
+
+// Reads the due conversion into sStreamData. Returns -1 if none is due, or while the filter settles
+static int8_t stream_take(){
+
+	uint32_t tmpCount = stream_due();
+	uint32_t tmpData;
+
+	if (tmpCount == 0){
+		return -1;
+	}
+
+	if (sStreamResync){
+		// Single read, it clears the ready flag
+		tmpData = ic1242_ReadData();
+		tmpCount = (sStreamEnd_us - sStreamRef_us + sStreamPeriod_us / 2) / sStreamPeriod_us;
+		if (tmpCount == 0){
+			tmpCount = 1;
+		}
+		sStreamRef_us = sStreamEnd_us;
+		sStreamIsReady = 0;
+		sStreamPoll_us = getUptime_us();
+	}else if (sStreamSyncCount + tmpCount >= STREAM_RESYNC_COUNT){
+		// Leave the continuous read to catch the next conversion end, the due conversion is read on the way
+		transferSpi(IC1242_CMD_READ_CSTOP);
+		IC1242_CS_DISABLE;
+		tmpData = ic1242_ReadData();
+		sStreamRef_us = sStreamRef_us + tmpCount * sStreamPeriod_us;
+		sStreamResync = 1;
+		sStreamIsReady = 0;
+		sStreamPoll_us = getUptime_us();
+	}else{
+		tmpData = ic1242_ShiftData();
+		sStreamRef_us = sStreamRef_us + tmpCount * sStreamPeriod_us;
+		sStreamSyncCount = sStreamSyncCount + tmpCount;
+	}
+	stream_count_miss(tmpCount);
+	if (sStreamSettle != 0){
+		sStreamSettle = sStreamSettle - 1;
+		return -1;
+	}
+	sStreamData = tmpData;
+
+	return 0;
 }
 
 
@@ -523,6 +832,53 @@ static void ic1242_WriteRegister(uint8_t inRegAddr, uint8_t inRegData){
 }
 
 
+// Data Ready bit of the setup register, it is active low
+static uint8_t ic1242_IsReady(){
+
+	uint8_t tmpDataRead = ic1242_ReadRegister(IC1242_REG_ACR);
+
+	return (tmpDataRead & (1 << IC1242_REG_ACR_BIT_NDRDY)) == 0;
+}
+
+
+// Conversion result with the read command
+static uint32_t ic1242_ReadData(){
+
+	uint32_t voltData = 0;
+	uint8_t *outSeq = (uint8_t *) &voltData;
+
+	// Send READ command
+	IC1242_CS_ENABLE;
+	transferSpi(IC1242_CMD_READ_DATA);
+
+	// Wait for data to be ready
+	_delay_us(150*sOscPeriod_uS);
+
+	// Get the register data
+	outSeq[2] = transferSpi(0);
+	outSeq[1] = transferSpi(0);
+	outSeq[0] = transferSpi(0);
+
+	IC1242_CS_DISABLE;
+
+	return voltData;
+}
+
+
+// Conversion result in the continuous read, chip select is already low
+static uint32_t ic1242_ShiftData(){
+
+	uint32_t voltData = 0;
+	uint8_t *outSeq = (uint8_t *) &voltData;
+
+	outSeq[2] = transferSpi(0);
+	outSeq[1] = transferSpi(0);
+	outSeq[0] = transferSpi(0);
+
+	return voltData;
+}
+
+
 static float ic1242_ConvertToVolt(uint32_t inData, uint8_t inIsDiff){
 
 	float outVolt = 0;
@@ -26,6 +26,15 @@ extern "C"{
 #include <stdint.h>
 
 
+// Conversions dropped after a channel, gain or data rate change while streaming, the filter settles
+#ifndef OTD_ANALOG_STREAM_SETTLE
+#define OTD_ANALOG_STREAM_SETTLE		2
+#endif
+// Clock difference between the converter and the MCU. The stream is synced again before it adds up to the read margin
+#ifndef OTD_ANALOG_STREAM_DRIFT_PPM
+#define OTD_ANALOG_STREAM_DRIFT_PPM		10000
+#endif
+
 
 enum OTD_ANALOG_TYPE{
 	OTD_ANALOG_VOLTAGE = 0,
@@ -85,6 +94,26 @@ void otd_SetAnalogGain(enum OTD_ANALOG_GAIN inAnaGain);
 enum OTD_ANALOG_GAIN otd_GetAnalogGain();
 uint8_t otd_IsAnalogDataReady();
 union OTD_ANALOG_VALUE otd_AnalogRead();
+/*
+ * ::: NOTE :::	Streaming keeps the converter in continuous read mode, so a sample costs only the 3 byte shift.
+ * 				Registers can not be read in this mode, so reads are timed from the data rate: the start waits
+ * 				for the end of a conversion (one period at most) and reads are done in the middle of the next ones.
+ * 				To follow the converter clock, the continuous read is left before the drift can reach the read
+ * 				margin (every 10 conversions at 10000ppm). Then each conversion is taken by the ready flag and a
+ * 				single read, nothing waits and no conversion is lost. The continuous read is timed again from the
+ * 				first conversion end which falls between two calls 1/32 period apart (1ms at 30Hz), so call that
+ * 				often to get back to the 3 byte reads. Setting the channel, the data rate or the gain stops and
+ * 				starts the stream.
+ * 				otd_AnalogRead() does the same bookkeeping as otd_AnalogStreamRead() and gives the last good
+ * 				conversion again if there is no new one. otd_AnalogGetStreamStatus() is -1 if the last start or
+ * 				sync timed out, the stream is stopped then.
+ */
+int8_t otd_AnalogStreamStart();
+void otd_AnalogStreamStop();
+uint8_t otd_AnalogIsStreaming();
+int8_t otd_AnalogStreamRead(union OTD_ANALOG_VALUE *outValue);
+uint16_t otd_AnalogGetStreamMissCount();
+int8_t otd_AnalogGetStreamStatus();
 
 
 #ifdef __cplusplus
@@ -17,6 +17,9 @@
   */ 
 
 #include "otd_CorePeri.h"
+#include "otd_Profile.h"
+#include "otd_Memory.h"
+#include "otd_Format.h"
 
 #ifdef __cplusplus
 extern "C"{
@@ -28,58 +31,130 @@ extern "C"{
 #include <util/delay.h>
 #include <string.h>
 #include <avr/wdt.h>
+#include <avr/eeprom.h>
+#include <avr/pgmspace.h>
 
 
 
 /*
  * DECLARATION OF STATIC FUNCTIONS
  */
-static void init_timer_adc();
 static int uart_init();
-void uart_delay();
-static char uart_getch();
+static void uart_bit_step();
+static void uart_tx_start();
+static void uart_tx_step();
+static void uart_rx_step();
+static int8_t uart_find_rate(uint32_t inBaud);
+static void uart_update_rx();
+static void uart_update_gap();
 //#define Reset_AVR() wdt_enable(WDTO_30MS); while(1) {}
 #define Reset_AVR() while(1) {}
 
-/*
- * TIMER (ADC) DEFINITIONS
- */
-#define ADC_CH_AMP0					11
-/*
- * ::: NOTE :::	I/O PLL input clock can be maximum 8MHz. So, by using Fuse bits internal RC OSC was used.
- * 				The ADC prescaler value "128" was used. Hence, in free running mode ADC conversion takes
- * 				"16" ADC clock cycles (8Mhz/128) results in 4KHz ADC completed interrupt.
- */
-#define ADC_SAMPLING_PERIOD_US		128
-unsigned long uptime_tick	= 0;
-
-
-
-
 /*
  * UART DEFINITIONS
  */
-#define UART_BAUD					19200
+#define UART_BAUD					OTD_UART_BAUD_DEFAULT
 #define UART_DDR					DDRD
 #define UART_PORT					PORTD
 #define UART_PIN					PIND
 #define UART_RX						2
 #define UART_TX						5
+// Cycles from the start bit edge to the bit timer start, estimated for the comparator interrupt. Not an exact count
+#define UART_RX_START_LATENCY		48
+// Bit timer interrupt needs about this much, slower rates are fine
+#define UART_MIN_BIT_CYCLES			100
+/*
+ * ::: NOTE :::	Bit period is a whole number of cycles, so the rate is a little off. Each side of a link may
+ * 				be off by about 2%, half of it is left for the RC oscillator.
+ */
+#define UART_BAUD_TOLERANCE_PPM		10000
+#define UART_BIT_CYCLES(baud)		((F_CPU + (baud)/2) / (baud))
+#define UART_BAUD_ERR_PPM(baud)		(((long long)F_CPU - (long long)UART_BIT_CYCLES(baud) * (baud)) * 1000000LL \
+										/ ((long long)UART_BIT_CYCLES(baud) * (baud)))
+#define UART_RATE_CHECK(baud)		static_assert(UART_BIT_CYCLES(baud) >= UART_MIN_BIT_CYCLES \
+										&& UART_BAUD_ERR_PPM(baud) <= UART_BAUD_TOLERANCE_PPM \
+										&& UART_BAUD_ERR_PPM(baud) >= -UART_BAUD_TOLERANCE_PPM, \
+										"UART rate is out of tolerance at this F_CPU")
+/*
+ * ::: NOTE :::	Rates above UART_RX_MAX_BAUD are transmit only, the receiver is off while one is selected.
+ * 				A receive sample is late by any interrupt or masked section running at the bit timer overflow,
+ * 				at 38400 only about 30 cycles of that fit in the bit. A late transmit edge moves only that
+ * 				edge, a receiver sampling at the bit middle tolerates about 85 cycles of it at 38400. Rerun
+ * 				extras/otd_uart_timing.py after changing a rate or a latency constant.
+ */
+#define UART_RX_MAX_BAUD			19200
+UART_RATE_CHECK(9600);
+UART_RATE_CHECK(19200);
+UART_RATE_CHECK(38400);
+struct uart_rate {
+	uint32_t baud;
+	uint16_t bitCycles;
+};
+static const struct uart_rate sRateTable[] PROGMEM = {
+	{9600,		UART_BIT_CYCLES(9600)},
+	{19200,		UART_BIT_CYCLES(19200)},
+	{38400,		UART_BIT_CYCLES(38400)}
+};
+#define UART_RATE_COUNT				(sizeof(sRateTable) / sizeof(struct uart_rate))
 //
-static uint8_t sDelayCount = 0;
-static uint8_t sTxMask = 0;
-static uint8_t sTxUnmask = 0;
 static uint8_t sRxMask = 0;
+static uint16_t sBitCycles = 0;
+static uint8_t sRateIndex = 0;
+/*
+ * ::: NOTE :::	A frame starts after 3.5 characters of silence (Modbus RTU t3.5). A character is 10 bits (8N1),
+ * 				above 19200 the gap is fixed to 1750us. One tick is added since a byte may come just before a tick.
+ */
+#define UART_GAP_BITS				35
+#define UART_GAP_FIXED_US			1750
+#define UART_GAP_FIXED_BAUD			19200
+static uint16_t sFrameGapTicks = 0;
+/*
+ * ::: NOTE :::	In multi-drop mode the first byte of a frame is the address. Frames for other nodes are dropped
+ * 				in the receive interrupt, so they never take room in the ring. Address 0 is broadcast.
+ */
+#define UART_ADDR_BROADCAST			0
+#define UART_ADDR_MAX				247
+static uint8_t sNodeId = 0;					// Zero is point to point, no filter
+static uint8_t sRxIsForeign = 0;
+static volatile uint8_t *sDirPort = 0;		// RS-485 driver enable, high while sending
+static uint8_t sDirMask = 0;
+/*
+ * ::: NOTE :::	Both directions are driven by the Timer/Counter1 overflow, one interrupt per bit. The UART is
+ * 				half duplex as before: a frame is either sent or received. A transmit waits for the received
+ * 				frame to complete. A start bit which comes while sending is counted as "rxBusyCount".
+ */
+#define UART_MODE_IDLE		0
+#define UART_MODE_TX		1
+#define UART_MODE_RX		2
+static volatile uint8_t sBitMode = UART_MODE_IDLE;
+static struct OTD_UART_STATS sStats;
+/*
+ * ::: NOTE :::	Print functions only put bytes into the transmit ring.
+ * 				Main loop writes "sTxHead" and the interrupt writes "sTxTail" only.
+ */
+#define UART_TX_BUF_SIZE	OTD_UART_TX_BUF_SIZE
+#define UART_RX_BUF_SIZE	OTD_UART_RX_BUF_SIZE
+static_assert((UART_TX_BUF_SIZE & (UART_TX_BUF_SIZE - 1)) == 0 && UART_TX_BUF_SIZE <= 256, "OTD_UART_TX_BUF_SIZE must be power of 2, max 256");
+static_assert((UART_RX_BUF_SIZE & (UART_RX_BUF_SIZE - 1)) == 0 && UART_RX_BUF_SIZE <= 256, "OTD_UART_RX_BUF_SIZE must be power of 2, max 256");
+static uint8_t sTxBuffer[UART_TX_BUF_SIZE];
+static volatile uint8_t sTxHead = 0;
+static volatile uint8_t sTxTail = 0;
+static uint16_t sTxShift = 0;				// Remaining bits of the frame, LSB first
+static uint8_t sTxBitCount = 0;
+static uint8_t sRxShift = 0;
+static uint8_t sRxBitCount = 0;
+static volatile uint32_t sRxLastTick = 0;	// Tick of the last received stop bit, used for frame gaps
 //
-#define UART_BUF_SIZE	64
-#define WRAP(x, y) if (++(x) == (y)) x = 0
-struct uart_buffer {
-	unsigned char buffer[UART_BUF_SIZE];
-	volatile  unsigned char size;
-	unsigned char in;
-	unsigned char out;
-};
-static struct uart_buffer sRx_stream;
+/*
+ * ::: NOTE :::	Receive ring has the same single producer/single consumer layout. The interrupt writes "sRxHead"
+ * 				and the main loop writes "sRxTail" only, so neither side needs to mask interrupts.
+ * 				One slot is kept empty to tell a full ring from an empty one.
+ */
+static uint8_t sRxBuffer[UART_RX_BUF_SIZE];
+static volatile uint8_t sRxHead = 0;
+static volatile uint8_t sRxTail = 0;
+// Reported by otd_Memory
+const uint16_t otd_RamUsage_Uart = sizeof(sRxBuffer) + sizeof(sTxBuffer);
 
 
 
@@ -94,7 +169,7 @@ void otd_InitCorePeri(){
 	wdt_disable();
 
 	// Used for timing
-	init_timer_adc();
+	otd_InitTimebase();
 	// Used for communication
 	uart_init();
 
@@ -108,6 +183,9 @@ void otd_InitCorePeri(){
 #include <avr/io.h>
 void otd_SoftReset(){
 
+	// Let the last messages out
+	otd_UartFlush();
+
 	// Enable soft reset
 	wdt_enable(WDTO_30MS);
 
@@ -121,113 +199,215 @@ void otd_SoftReset(){
 
 
 /*
- * TIMER (ADC) FUNCTIONS
+ * UART FUCNTIONS
  */
-unsigned long getUptime_ms(){
-	/*
-	 * ::: NOTE :::	ADC sampling period for 8MHz inter OSC Rc clock with prescaler 2 is ~4us.
-	 * 				4 = (1000×1000÷(8×1000×1000÷2÷16))
-	 */
-	/*
-	 * ::: NOTE :::	ADC runs a little bit faster so "1028" is for calibration
-	 */
-	return (uptime_tick*ADC_SAMPLING_PERIOD_US/1000);
+void otd_UartPrintByte(uint8_t inData){
+
+	uint8_t nextHead = (sTxHead + 1) & (UART_TX_BUF_SIZE - 1);
+
+	// Wait for room in the ring
+	while (nextHead == sTxTail){
+		if ((SREG & _BV(SREG_I)) == 0){
+			// Called with interrupts masked, so the bit timer interrupt can not run. Step it from here
+			if (TIFR1 & _BV(TOV1)){
+				TIFR1 = _BV(TOV1);
+				otd_CycleTimerReload(sBitCycles);
+				uart_bit_step();
+			}
+		}
+	}
+	sTxBuffer[sTxHead] = inData;
+	sTxHead = nextHead;
+
+	// Start the transmitter if it is stopped. While receiving, it is started at the end of the frame
+	uint8_t oldSREG = SREG;
+	cli();
+	OTD_PROFILE_CLI_BEGIN();
+	if (sBitMode == UART_MODE_IDLE){
+		uart_tx_start();
+	}
+	OTD_PROFILE_CLI_END();
+	SREG = oldSREG;
+
+	return;
 }
 
-static void init_timer_adc(){
 
-	/*
-	 * ::: NOTE :::	We are using ADC as a timer. Becuase the AT90PWM161 does not have a usable timer
-	 */
-	// First configure ADC "Digital Input Disable Register"
-	DIDR0 = 0;			// :::No channel for ADC sampling
-	DIDR1 = 0;
+// Waits until all bytes in the ring are sent, including the stop bit of the last one
+void otd_UartFlush(){
 
+	while (sTxHead != sTxTail || sBitMode == UART_MODE_TX){
+		if ((SREG & _BV(SREG_I)) == 0){
+			if (TIFR1 & _BV(TOV1)){
+				TIFR1 = _BV(TOV1);
+				otd_CycleTimerReload(sBitCycles);
+				uart_bit_step();
+			}
+		}
+	}
+
+	return;
+}
 
 
-	// As DIDR of the adc input is not disabled. Any value should be fine. Set ADC Multiplexer Register as regular
-	ADMUX  = _BV(REFS1) | _BV(REFS0)	// Internal 2.56V reference voltage with  PE3 pin free as port
-				| _BV(ADLAR)   			// left adjust result
-				| ADC_CH_AMP0;       	// initial input channel = AMP0
+uint8_t otd_UartTxPending(){
+	return (uint8_t)(sTxHead - sTxTail) & (UART_TX_BUF_SIZE - 1);
+}
 
-	//
-	ADCSRB = 0 | _BV(ADHSM);	// high speed mode and auto trigger source = self
 
+int8_t otd_UartSetBaud(uint32_t inBaud){
 
-	ADCSRA = _BV(ADEN)    		// enable ADC
-				| _BV(ADATE)   	// enable auto trigger
-				| _BV(ADIE)    	// enable interrupt
-				| _BV(ADPS0) | _BV(ADPS1) | _BV(ADPS2);	// prescaler = 128
-	ADCSRA &= ~(1<<ADIF);		// clear interrupt flag
+	int8_t tmpRate = uart_find_rate(inBaud);
+	if (tmpRate < 0){
+		return -1;
+	}
 
+	// Let the queued bytes out with the old rate
+	otd_UartFlush();
+
+	// Change between frames only. A frame may be coming in
+	while (1){
+		uint8_t oldSREG = SREG;
+		cli();
+		if (sBitMode == UART_MODE_IDLE){
+			sRateIndex = (uint8_t)tmpRate;
+			sBitCycles = pgm_read_word(&sRateTable[sRateIndex].bitCycles);
+			uart_update_gap();
+			uart_update_rx();
+			SREG = oldSREG;
+			break;
+		}
+		SREG = oldSREG;
+	}
 
-	/*
-	 * ::: NOTE :::	If we do not enable Amplifier, ADC conversion does not start.
-	 */
-	AMP0CSR = _BV(AMP0EN)		// Enable Amplifier
-				| _BV(AMP0GS);	// Use ground instead of AMP0-
+	return 0;
+}
 
-	_delay_us(9);         		// let the conversion start
 
-	sei();
+uint32_t otd_UartGetBaud(){
+	return pgm_read_dword(&sRateTable[sRateIndex].baud);
+}
+
+
+// Returns (achieved - requested) / requested rate in ppm, with the nominal F_CPU
+int16_t otd_UartGetBaudError(){
+
+	uint32_t tmpBaud = pgm_read_dword(&sRateTable[sRateIndex].baud);
+	uint32_t tmpProduct = (uint32_t)pgm_read_word(&sRateTable[sRateIndex].bitCycles) * tmpBaud;
+	int32_t tmpDiff = (int32_t)(F_CPU - tmpProduct);
+
+	// Split the scale so that nothing overflows 32 bits
+	return (int16_t)((tmpDiff * 1000L) / (int32_t)(tmpProduct / 1000UL));
+}
+
+
+uint32_t otd_UartGetLastRxTick(){
+
+	uint32_t tmpTick;
+
+	uint8_t oldSREG = SREG;
+	cli();
+	tmpTick = sRxLastTick;
+	SREG = oldSREG;
+
+	return tmpTick;
+}
+
+
+uint16_t otd_UartGetFrameGapTicks(){
+	return sFrameGapTicks;
+}
+
+
+// Zero turns the address filter off. Otherwise only frames for "inNodeId" and broadcast are received
+int8_t otd_UartSetMultiDrop(uint8_t inNodeId){
+
+	if (inNodeId > UART_ADDR_MAX){
+		return -1;
+	}
+
+	uint8_t oldSREG = SREG;
+	cli();
+	sNodeId = inNodeId;
+	sRxIsForeign = 0;
+	SREG = oldSREG;
+
+	return 0;
+}
+
+
+// Null port turns it off. e.g. otd_UartSetDirPin(&PORTB, 4)
+void otd_UartSetDirPin(volatile uint8_t *inPort, uint8_t inPin){
 
-	ADCSRA |= (1<<ADSC);		// Start conversion
+	// Let the queued bytes out with the old pin
+	otd_UartFlush();
+
+	uint8_t oldSREG = SREG;
+	cli();
+	if (sDirPort != 0){
+		*sDirPort &= ~sDirMask;
+	}
+	sDirPort = inPort;
+	sDirMask = _BV(inPin);
+	if (sDirPort != 0){
+		// DDRx is right below PORTx on the AVR
+		*sDirPort &= ~sDirMask;
+		*(sDirPort - 1) |= sDirMask;
+	}
+	SREG = oldSREG;
 
 	return;
 }
-// ADC interrupt service routine.
-ISR(ADC_vect)
-{
-	// Increment tick counter
-	uptime_tick = uptime_tick +1;
 
+
+// Returns the stored node ID (1..247) or -1 when none is stored
+int16_t otd_NodeIdLoad(){
+
+	uint8_t tmpId = eeprom_read_byte((const uint8_t *)OTD_EEADDR_NODE_ID);
+	uint8_t tmpCheck = eeprom_read_byte((const uint8_t *)(OTD_EEADDR_NODE_ID + 1));
+
+	// Erased EEPROM (0xFF) fails the check
+	if (tmpCheck != (uint8_t)~tmpId || tmpId == UART_ADDR_BROADCAST || tmpId > UART_ADDR_MAX){
+		return -1;
+	}
+
+	return tmpId;
 }
 
 
+int8_t otd_NodeIdSave(uint8_t inNodeId){
 
+	if (inNodeId == UART_ADDR_BROADCAST || inNodeId > UART_ADDR_MAX){
+		return -1;
+	}
 
+	eeprom_update_byte((uint8_t *)OTD_EEADDR_NODE_ID, inNodeId);
+	eeprom_update_byte((uint8_t *)(OTD_EEADDR_NODE_ID + 1), (uint8_t)~inNodeId);
 
+	return 0;
+}
 
-/*
- * UART FUCNTIONS
- */
-void otd_UartPrintByte(uint8_t inData){
 
+void otd_UartGetStats(struct OTD_UART_STATS *outStats){
+
+	// Counters are updated from the interrupts
 	uint8_t oldSREG = SREG;
-	cli(); //Prevent interrupts from breaking the transmission. Note: TinySoftwareSerial is half duplex.
-	//it can either recieve or send, not both (because recieving requires an interrupt and would stall transmission
-	__asm__ __volatile__ (
-		"   com %[ch]\n" // ones complement, carry set
-		"   sec\n"
-		"1: brcc 2f\n"					// Branch if Carry Cleared
-		"   in r23,%[uartPort] \n"
-		"   and r23,%[uartUnmask]\n"
-		"   out %[uartPort],r23 \n"
-		"   rjmp 3f\n"
-		"2: in r23,%[uartPort] \n"
-		"   or r23,%[uartMask]\n"
-		"   out %[uartPort],r23 \n"
-		"   nop\n"
-		"3: rcall uart_delay\n"
-		"   rcall uart_delay\n"
-		"   rcall uart_delay\n"
-		"   rcall uart_delay\n"
-		"   lsr %[ch]\n"
-		"   dec %[count]\n"
-		"   brne 1b\n"
-		:
-		:
-		  [ch] "r" (inData),
-		  [count] "r" ((uint8_t)10),
-		  [uartPort] "I" (_SFR_IO_ADDR(UART_PORT)),
-		  [uartMask] "r" (sTxMask),
-		  [uartUnmask] "r" (sTxUnmask)
-		: "r23",
-		  "r24",
-		  "r25"
-	);
+	cli();
+	*outStats = sStats;
 	SREG = oldSREG;
-	sei();
+
+	return;
+}
+
+
+void otd_UartResetStats(){
+
+	uint8_t oldSREG = SREG;
+	cli();
+	memset(&sStats, 0, sizeof(struct OTD_UART_STATS));
+	SREG = oldSREG;
+
+	return;
 }
 
 void otd_UartPrint(char *inStr){
@@ -236,9 +416,8 @@ void otd_UartPrint(char *inStr){
 
 
 void otd_UartPrintInt(int inData){
-	char tmpStr[16];
-	memset(tmpStr, 0, sizeof(char)*16);
-	itoa(inData, tmpStr, 10);
+	char tmpStr[8];
+	otd_FormatInt(tmpStr, inData);
 	otd_UartPrint(tmpStr);
 }
 
@@ -256,21 +435,47 @@ void otd_UartPrintln(char *inStr){
 }
 
 int16_t otd_UartRead(uint8_t inCanBlock){
+
+	uint8_t tmpTail = sRxTail;
+
 	if (inCanBlock == 1){
-		while (sRx_stream.size <= 0);
-		char c = *(sRx_stream.buffer + sRx_stream.out);
-		WRAP(sRx_stream.out, UART_BUF_SIZE);
-		--sRx_stream.size;
-		return c;
-	}else{
-		if(sRx_stream.size <= 0){
-			return -1;
-		}
-		char c = *(sRx_stream.buffer + sRx_stream.out);
-		WRAP(sRx_stream.out, UART_BUF_SIZE);
-		--sRx_stream.size;
-		return c;
+		while (tmpTail == sRxHead);
+	}else if (tmpTail == sRxHead){
+		return -1;
 	}
+	// Read the byte only after the head is seen
+	__asm__ __volatile__("" ::: "memory");
+
+	uint8_t c = sRxBuffer[tmpTail];
+	// Release the slot after the byte is taken
+	sRxTail = (tmpTail + 1) & (UART_RX_BUF_SIZE - 1);
+
+	return c;
+}
+
+
+uint8_t otd_UartAvailable(){
+	return (uint8_t)(sRxHead - sRxTail) & (UART_RX_BUF_SIZE - 1);
+}
+
+
+// Copies up to "inMaxLen" received bytes, returns the number of bytes copied
+uint8_t otd_UartReadBuffer(uint8_t *outBuffer, uint8_t inMaxLen){
+
+	uint8_t tmpTail = sRxTail;
+	uint8_t tmpHead = sRxHead;
+	uint8_t readCount = 0;
+	// Read the bytes only after the head is seen
+	__asm__ __volatile__("" ::: "memory");
+
+	while (tmpTail != tmpHead && readCount < inMaxLen){
+		outBuffer[readCount] = sRxBuffer[tmpTail];
+		tmpTail = (tmpTail + 1) & (UART_RX_BUF_SIZE - 1);
+		readCount = readCount + 1;
+	}
+	sRxTail = tmpTail;
+
+	return readCount;
 }
 
 
@@ -285,23 +490,27 @@ void otd_UartWrite(uint8_t inData){
 static int uart_init(){
 
 
-	// Reset software uart buffer
-	memset(&sRx_stream, 0, sizeof(struct uart_buffer));
+	// Reset software uart buffers
+	sRxHead = 0;
+	sRxTail = 0;
 
-	// Calculate delay count
-	long tempDelay = (((F_CPU/UART_BAUD)-39)/12);
-	if ((tempDelay > 255) || (tempDelay <= 0)){
-		return -1; //Cannot start as it would screw up uartDelay().
+	// Bit period for the bit timer
+	int8_t tmpRate = uart_find_rate(UART_BAUD);
+	if (tmpRate < 0){
+		return -1; //Cannot start, rate is not in the table.
 	}
-	sDelayCount = (uint8_t)tempDelay;
+	sRateIndex = (uint8_t)tmpRate;
+	sBitCycles = pgm_read_word(&sRateTable[sRateIndex].bitCycles);
+	uart_update_gap();
+	sBitMode = UART_MODE_IDLE;
+	sTxHead = 0;
+	sTxTail = 0;
+	memset(&sStats, 0, sizeof(struct OTD_UART_STATS));
 
 
 	// Configure TX pin
 	UART_DDR  |= (1<<UART_TX);
 	UART_PORT |= (1<<UART_TX);
-	// Set mask unmask byte
-	sTxMask = _BV(UART_TX);
-	sTxUnmask = ~sTxMask;
 
 	// Configure RX pin
 	UART_DDR &= ~(1 << UART_RX);
@@ -318,8 +527,8 @@ static int uart_init(){
 	//
 	AC1CON |= (1 << AC1IS1);  //interrupt on falling edge (this means RX has gone from Mark state to Start bit state).
 	//
-	AC1CON |= (1 << AC1IE);  //turn on the comparator interrupt to allow us to use it for RX
 	AC1CON |= (1 << AC1EN);	//turn on the comparator for RX
+	uart_update_rx();  //turn on the comparator interrupt to allow us to use it for RX, if the rate can receive
 
 	// Enable digital input register
 	DIDR0 &= ~(1 << ADC0D);
@@ -327,68 +536,209 @@ static int uart_init(){
 	return 0;
 }
 
-void uart_delay() {
-	__asm__ __volatile__ (
-	  "mov r25,%[count]\n"
-	  "1:dec r25\n"
-      "brne 1b\n"
-      "ret\n"
-	  ::[count] "r" ((uint8_t)sDelayCount)
-	);
+ISR(ANALOG_COMP_1_vect){
+	OTD_PROFILE_ISR_ENTER();
+
+	// Check wrong detection. Note that uart has start bit value "0"
+	if ( (PIND & sRxMask) == sRxMask){
+		OTD_PROFILE_ISR_EXIT(OTD_PROFILE_ISR_ANALOG_COMP_1);
+		return;
+	}
+
+	// Half duplex, can not receive while sending
+	if (sBitMode != UART_MODE_IDLE){
+		sStats.rxBusyCount = sStats.rxBusyCount + 1;
+		OTD_PROFILE_ISR_EXIT(OTD_PROFILE_ISR_ANALOG_COMP_1);
+		return;
+	}
+
+	// First sample is at the middle of the first data bit, 1.5 bit after the edge
+	otd_CycleTimerStart(sBitCycles + sBitCycles/2 - UART_RX_START_LATENCY);
+	TIMSK1 |= _BV(TOIE1);
+	sBitMode = UART_MODE_RX;
+	sRxShift = 0;
+	sRxBitCount = 0;
+	// Data bits would trigger the comparator again, it is enabled back after the stop bit
+	AC1CON &= ~(1 << AC1IE);
+
+	// Start bit can be the calibration reference
+	otd_TimebaseCalibEdge(OTD_CALIB_SRC_UART_RX);
+
+	OTD_PROFILE_ISR_EXIT(OTD_PROFILE_ISR_ANALOG_COMP_1);
+}
+
+
+// Call with interrupts masked
+static void uart_tx_start(){
+
+	sBitMode = UART_MODE_TX;
+	sTxBitCount = 0;
+	if (sDirPort != 0){
+		// Enable the driver one bit before the start bit, so the line settles
+		*sDirPort |= sDirMask;
+	}
+	// Start bit goes out on the first overflow like every other bit, so all edges have the same interrupt latency
+	otd_CycleTimerStart(sBitCycles);
+	TIMSK1 |= _BV(TOIE1);
+
+	return;
 }
 
 
+// Sends one bit. Called on every bit timer overflow
+static void uart_tx_step(){
+
+	if (sTxBitCount == 0){
+		// Previous frame is completed with its stop bit. Take the next byte
+		uint8_t tmpTail = sTxTail;
+		if (tmpTail == sTxHead){
+			// Release the bus right after the last stop bit
+			if (sDirPort != 0){
+				*sDirPort &= ~sDirMask;
+			}
+			TIMSK1 &= ~_BV(TOIE1);
+			sBitMode = UART_MODE_IDLE;
+			return;
+		}
+		// Start bit "0", 8 data bits and stop bit "1"
+		sTxShift = ((uint16_t)sTxBuffer[tmpTail] << 1) | 0x200;
+		sTxBitCount = 10;
+		sTxTail = (tmpTail + 1) & (UART_TX_BUF_SIZE - 1);
+	}
 
-ISR(ANALOG_COMP_1_vect){
-	// Check wrong detection. Note that uart has start bit value "0"
-	if ( (PIND & sRxMask) == sRxMask){
+	if (sTxShift & 1){
+		UART_PORT |= _BV(UART_TX);
+	}else{
+		UART_PORT &= ~_BV(UART_TX);
+	}
+	sTxShift >>= 1;
+	sTxBitCount = sTxBitCount - 1;
+
+	return;
+}
+
+
+static void uart_update_gap(){
+
+	uint32_t tmpBaud = pgm_read_dword(&sRateTable[sRateIndex].baud);
+	uint32_t tmpGap_us = (tmpBaud > UART_GAP_FIXED_BAUD) ? UART_GAP_FIXED_US : (UART_GAP_BITS * 1000000UL) / tmpBaud;
+
+	sFrameGapTicks = (uint16_t)((tmpGap_us + OTD_TICK_PERIOD_US - 1) / OTD_TICK_PERIOD_US) + 1;
+
+	return;
+}
+
+
+// Receiver is on for the rates it can sample. Call with interrupts masked, between frames
+static void uart_update_rx(){
+
+	if (pgm_read_dword(&sRateTable[sRateIndex].baud) > UART_RX_MAX_BAUD){
+		AC1CON &= ~(1 << AC1IE);
+	}else if ((AC1CON & (1 << AC1IE)) == 0){
+		// Drop an edge seen while it was off. Flags clear by writing one
+		ACSR = _BV(AC1IF);
+		AC1CON |= (1 << AC1IE);
+	}
+
+	return;
+}
+
+
+static int8_t uart_find_rate(uint32_t inBaud){
+
+	for (uint8_t i = 0; i < UART_RATE_COUNT; i++){
+		if (pgm_read_dword(&sRateTable[i].baud) == inBaud){
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+
+// Samples one bit. Called on every bit timer overflow
+static void uart_rx_step(){
+
+	uint8_t tmpBit = UART_PIN & sRxMask;
+
+	// Data bits, LSB first
+	if (sRxBitCount < 8){
+		sRxShift >>= 1;
+		if (tmpBit){
+			sRxShift |= 0x80;
+		}
+		sRxBitCount = sRxBitCount + 1;
 		return;
 	}
 
-	char ch = uart_getch();
-
-	sRx_stream.buffer[sRx_stream.in] = ch;
-	WRAP(sRx_stream.in, UART_BUF_SIZE);
-	++sRx_stream.size;
-
-}
-
-
-static char uart_getch() {
-  uint8_t ch = 0;
-    __asm__ __volatile__ (
-		"   rcall uart_delay\n"          // Get to 0.25 of start bit (our baud is too fast, so give room to correct)
-		"1: rcall uart_delay\n"              // Wait 0.25 bit period
-		"   rcall uart_delay\n"              // Wait 0.25 bit period
-		"   rcall uart_delay\n"              // Wait 0.25 bit period
-		"   rcall uart_delay\n"              // Wait 0.25 bit period
-		"   clc\n"
-		"   in r23,%[pin]\n"
-		"   and r23, %[mask]\n"
-		"   breq 2f\n"
-		"   sec\n"
-		"2: ror   %0\n"
-		"   dec   %[count]\n"
-		"   breq  3f\n"
-		"   rjmp  1b\n"
-		"3: rcall uart_delay\n"              // Wait 0.25 bit period
-		"   rcall uart_delay\n"              // Wait 0.25 bit period
-		:
-		  "=r" (ch)
-		:
-		  "0" ((uint8_t)0),
-		  [count] "r" ((uint8_t)8),
-		  [pin] "I" (_SFR_IO_ADDR(UART_PIN)),
-		  [mask] "r" (sRxMask)
-		:
-		  "r23",
-		  "r24",
-		  "r25"
-    );
-	return ch;
+	uint32_t tmpNow = getUptime_ticks();
+	uint8_t isFrameStart = (tmpNow - sRxLastTick) >= sFrameGapTicks;
+	sRxLastTick = tmpNow;
+
+	// Stop bit must be "1", otherwise the byte is dropped
+	if (tmpBit == 0){
+		sStats.framingErrorCount = sStats.framingErrorCount + 1;
+		if (isFrameStart){
+			// Address is not known, drop the frame
+			sRxIsForeign = (sNodeId != 0);
+		}
+	}else if (sNodeId != 0 && isFrameStart && sRxShift != sNodeId && sRxShift != UART_ADDR_BROADCAST){
+		sRxIsForeign = 1;
+		sStats.filteredFrameCount = sStats.filteredFrameCount + 1;
+	}else if (sNodeId != 0 && isFrameStart == 0 && sRxIsForeign){
+		// Rest of a frame for another node
+	}else{
+		sRxIsForeign = 0;
+		uint8_t tmpHead = sRxHead;
+		uint8_t nextHead = (tmpHead + 1) & (UART_RX_BUF_SIZE - 1);
+		if (nextHead == sRxTail){
+			sStats.overrunCount = sStats.overrunCount + 1;
+		}else{
+			sRxBuffer[tmpHead] = sRxShift;
+			// Publish the byte after it is stored. The buffer is not volatile, keep the compiler from moving the store
+			__asm__ __volatile__("" ::: "memory");
+			sRxHead = nextHead;
+		}
+	}
+
+	// Wait for the next start bit. We are at the middle of the stop bit, so the edge is still ahead
+	// Flags clear by writing one, a read-modify-write would clear the other comparator flags too
+	ACSR = _BV(AC1IF);
+	AC1CON |= (1 << AC1IE);
+
+	// Send what is queued meanwhile
+	if (sTxHead != sTxTail){
+		uart_tx_start();
+	}else{
+		TIMSK1 &= ~_BV(TOIE1);
+		sBitMode = UART_MODE_IDLE;
+	}
+
+	return;
+}
+
+
+static void uart_bit_step(){
+
+	if (sBitMode == UART_MODE_RX){
+		uart_rx_step();
+	}else if (sBitMode == UART_MODE_TX){
+		uart_tx_step();
+	}
+
+	return;
 }
 
 
+ISR(TIMER1_OVF_vect){
+	// Reload first, it is timing critical
+	otd_CycleTimerReload(sBitCycles);
+
+	OTD_PROFILE_ISR_ENTER();
+	uart_bit_step();
+	OTD_PROFILE_ISR_EXIT(OTD_PROFILE_ISR_TIMER1_OVF);
+}
+
 
 enum LAST_RESET_TYPE getLastResetCause(){
 
@@ -25,6 +25,24 @@ extern "C"{
 
 
 #include <inttypes.h>
+#include "otd_Timebase.h"
+
+
+// Software UART ring sizes in bytes, must be power of 2. One byte of each is kept empty
+// Rate after otd_InitCorePeri(). 9600 and 19200 are supported, 38400 is transmit only
+#ifndef OTD_UART_BAUD_DEFAULT
+#define OTD_UART_BAUD_DEFAULT	19200
+#endif
+// EEPROM location of the node ID (2 bytes), after the timebase trim
+#ifndef OTD_EEADDR_NODE_ID
+#define OTD_EEADDR_NODE_ID		0x06
+#endif
+#ifndef OTD_UART_TX_BUF_SIZE
+#define OTD_UART_TX_BUF_SIZE	32
+#endif
+#ifndef OTD_UART_RX_BUF_SIZE
+#define OTD_UART_RX_BUF_SIZE	64
+#endif
 
 
 enum LAST_RESET_TYPE{
@@ -36,20 +54,56 @@ enum LAST_RESET_TYPE{
 };
 
 
+struct OTD_UART_STATS {
+	uint16_t framingErrorCount;		// Stop bit was "0", byte dropped
+	uint16_t overrunCount;			// Receive ring was full, byte dropped
+	uint16_t rxBusyCount;			// Start bit came while sending (half duplex), byte lost
+	uint16_t filteredFrameCount;	// Frames for other nodes in multi-drop mode
+};
+
+
 // CORE
 enum LAST_RESET_TYPE getLastResetCause();
 void otd_InitCorePeri();
 void otd_SoftReset();
-// TIMER
-unsigned long getUptime_ms();
 // UART
+/*
+ * ::: NOTE :::	Print functions return as soon as the bytes are in the transmit ring, they wait only if it is full.
+ * 				Call otd_UartFlush() when the transmission must be completed, e.g. before a reset or sleep.
+ */
 void otd_UartPrintByte(uint8_t inData);
+void otd_UartFlush();
+uint8_t otd_UartTxPending();
 void otd_UartPrint(char *inStr);
 void otd_UartPrintInt(int inData);
 void otd_UartPrintFloat(float inData);
 void otd_UartPrintln(char *inStr);
 int16_t otd_UartRead(uint8_t inCanBlock);
+uint8_t otd_UartAvailable();
+uint8_t otd_UartReadBuffer(uint8_t *outBuffer, uint8_t inMaxLen);
 void otd_UartWrite(uint8_t inData);
+/*
+ * ::: NOTE :::	At 19200 a receive sample tolerates about 70 cycles of delay from another interrupt routine or
+ * 				masked section, 150 at 9600. Measure them with otd_Profile and check with extras/otd_uart_timing.py.
+ * 				38400 is for output only, e.g. logging: nothing is received while it is selected. Its transmit
+ * 				edges tolerate about 85 cycles of such delay.
+ */
+int8_t otd_UartSetBaud(uint32_t inBaud);
+uint32_t otd_UartGetBaud();
+int16_t otd_UartGetBaudError();
+uint32_t otd_UartGetLastRxTick();
+uint16_t otd_UartGetFrameGapTicks();
+/*
+ * ::: NOTE :::	Multi-drop (RS-485) bus: many boards share one line. The first byte after a frame gap is the
+ * 				node address, frames for other nodes are dropped in the interrupt. The driver enable pin is
+ * 				set one bit before the first start bit and cleared right after the last stop bit.
+ */
+int8_t otd_UartSetMultiDrop(uint8_t inNodeId);
+void otd_UartSetDirPin(volatile uint8_t *inPort, uint8_t inPin);
+int16_t otd_NodeIdLoad();
+int8_t otd_NodeIdSave(uint8_t inNodeId);
+void otd_UartGetStats(struct OTD_UART_STATS *outStats);
+void otd_UartResetStats();
 
 
 #ifdef __cplusplus
@@ -24,173 +24,531 @@ extern "C"{
 
 
 #include <avr/io.h>
-#include <util/delay.h>
-#include "otd_CorePeri.h"
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+#include "otd_Timebase.h"
+#include "otd_Profile.h"
+#include "otd_Memory.h"
+#include <string.h>
 
 
-#define BIT_SET(a,b) ((a) |= (1ULL<<(b)))
 // Output enable pin
 #define DIGOUT_EN_PORT		PORTD
 #define DIGOUT_EN_PIN		4
+// Digital input interface IC, 7 bit address
+#define DIGIN_I2C_ADDR		0x20
+// Input bytes of the widest expander
+#define DIGIN_DEVICE_WIDTH_MAX	2
+// Output pins, in DIGITAL_OUTPUT_PINS order
+#define DIGOUT_PORT_B		0
+#define DIGOUT_PORT_D		1
+#define DIGOUT_PORT_COUNT	2
+struct digout_pin {
+	uint8_t port;
+	uint8_t bit;					// Mask
+};
+// Port bits of a write
+struct digout_bits {
+	uint8_t set[DIGOUT_PORT_COUNT];
+	uint8_t clr[DIGOUT_PORT_COUNT];
+};
+static const struct digout_pin sOutputPin[DIGITAL_OUTPUT_COUNT] PROGMEM = {
+	{DIGOUT_PORT_B, (1 << 7)},		// OUT 0
+	{DIGOUT_PORT_B, (1 << 0)},		// OUT 1
+	{DIGOUT_PORT_B, (1 << 2)},		// OUT 2
+	{DIGOUT_PORT_B, (1 << 3)},		// OUT 3
+	{DIGOUT_PORT_D, (1 << 6)},		// OUT 4
+	{DIGOUT_PORT_D, (1 << 3)}		// OUT 5
+};
 
 
+static volatile uint8_t sOutputShadow = 0;
+struct digout_timed {
+	uint16_t period_ms;
+	uint16_t on_ms;
+	uint16_t phase_ms;
+	uint16_t count;					// Cycles left, 0 runs until stopped
+};
+static struct digout_timed sTimed[DIGITAL_OUTPUT_COUNT];
+static volatile uint8_t sTimedMask = 0;
+//
+static struct OTD_I2C_XFER sInputXfer;
+static uint8_t sInputByte = 0;
+static uint8_t sIsInputStarted = 0;
+//
+static struct OTD_I2C_XFER sRefreshXfer;
+static uint8_t sRefreshRaw[DIGIN_DEVICE_WIDTH_MAX];
+static uint16_t sRefreshPeriod_ms = OTD_DIGIN_REFRESH_MS;
+static uint16_t sRefreshCountdown_ms = 1;
+static volatile uint8_t sSnapshot = 0;
+static volatile uint32_t sSnapshotTime_ms = 0;
+static volatile uint8_t sIsSnapshotValid = 0;
+static uint8_t sIsHooked = 0;
+//
+static_assert(OTD_DIGIN_INPUT_BYTES >= 1 && OTD_DIGIN_INPUT_BYTES <= 8, "OTD_DIGIN_INPUT_BYTES must be 1 to 8");
+static struct OTD_DIGIN_DEVICE sDevice[OTD_DIGIN_DEVICE_MAX];
+static uint8_t sDeviceCount = 0;
+static uint8_t sInputByteCount = 0;
+static uint8_t sScanBytes[OTD_DIGIN_INPUT_BYTES];		// Last good inputs, device order
+static volatile uint32_t sScanTime_ms = 0;
+static uint8_t sScanDevice = 0;
+static uint8_t sScanOffset = 0;
+static int8_t sScanStatus = OTD_I2C_OK;
+static uint32_t sScanStart_us = 0;
+static struct OTD_DIGIN_SCAN_STATS sScanStats;
 /*
- * DECLARATIONS
+ * ::: NOTE :::	Vertical counter: bit n of sCount[k] is bit k of the counter of input n. Thresholds are
+ * 				kept the same way, so all inputs are counted and compared with a few byte operations.
  */
-static uint8_t reverse_bit8(uint8_t x);
-static void I2C_Init();
-static void I2C_Start();
-static void I2C_Stop();
-static uint8_t I2C_Write_Byte(unsigned char IIC_Byte);
-static void I2C_Read_Byte( uint8_t *);
+#define DEBOUNCE_BITS		4
+#define DEBOUNCE_MAX		((1 << DEBOUNCE_BITS) - 1)
+static_assert((OTD_DIGIN_EVENT_QUEUE_SIZE & (OTD_DIGIN_EVENT_QUEUE_SIZE - 1)) == 0, "OTD_DIGIN_EVENT_QUEUE_SIZE must be a power of 2");
+static uint16_t sDebounce_ms[8];
+static uint8_t sThreshold[DEBOUNCE_BITS];
+static uint8_t sCount[DEBOUNCE_BITS];
+static volatile uint8_t sDebounced = 0;
+static uint8_t sIsDebounceStarted = 0;
+static struct OTD_DIGIN_EVENT sEventQueue[OTD_DIGIN_EVENT_QUEUE_SIZE];
+static volatile uint8_t sEventHead = 0;
+static volatile uint8_t sEventTail = 0;
+static volatile uint16_t sEventOverrunCount = 0;
 //
+struct digin_counter {
+	uint32_t count;
+	uint32_t lastEdge_ms;
+	uint32_t prevEdge_ms;
+	uint32_t gateFirstEdge_ms;
+	uint16_t gateEdges;
+	uint16_t resultEdges;			// Of the last complete gate
+	uint32_t resultSpan_ms;			// From the first to the last edge of the last complete gate
+};
+static_assert(OTD_DIGIN_COUNTER_COUNT <= 8, "OTD_DIGIN_COUNTER_COUNT must not exceed the input count");
+static struct digin_counter sCounter[OTD_DIGIN_COUNTER_COUNT];
+static uint16_t sGate_ms = OTD_DIGIN_GATE_MS;
+static uint16_t sGateCountdown_ms = OTD_DIGIN_GATE_MS;
+// Reported by otd_Memory
+const uint16_t otd_RamUsage_DigitalIO = sizeof(sDebounce_ms) + sizeof(sEventQueue) + sizeof(sCounter) +
+											sizeof(sDevice) + sizeof(sScanBytes) + sizeof(sScanStats) + sizeof(sTimed);
+
+
+/*
+ * DECLARATIONS
+ */
 static void init_digital_output();
+static void digital_tick();
+static void digin_tick();
+static void digout_tick();
+static void digout_collect(uint8_t inMask, uint8_t inValues, struct digout_bits *outBits);
+static void digout_write(const struct digout_bits *inBits, uint8_t inMask, uint8_t inValues);
+static int8_t digout_start(uint8_t inOutputPin, uint16_t inPeriod_ms, uint16_t inOn_ms, uint16_t inCount);
+static void digin_refresh_done(struct OTD_I2C_XFER *inXfer);
+static void scan_start();
+static int8_t scan_submit();
+static void scan_store(uint8_t inDevice, uint8_t inOffset, const uint8_t *inRaw, uint32_t inTime_ms);
+static void scan_record(int8_t inStatus, uint32_t inTime_us, uint32_t inTime_ms);
+static OTD_DIGIN_WORD scan_word();
+static void debounce_thresholds();
+static void debounce_sample(uint8_t inInputs, uint32_t inTime_ms);
+static void counter_edges(uint8_t inRising, uint32_t inTime_ms);
+static void counter_gate();
 
 
 void otd_InitDigitalIO(){
 	/* Initialize Digital Input */
-	I2C_Init();
+	otd_InitI2c();
+	sSnapshot = 0;
+	sSnapshotTime_ms = 0;
+	sIsSnapshotValid = 0;
+	sDevice[0].addr = DIGIN_I2C_ADDR;
+	sDevice[0].width = 1;
+	sDevice[0].isInverted = 1;
+	sDeviceCount = 1;
+	sInputByteCount = 1;
+	memset(sScanBytes, 0, sizeof(sScanBytes));
+	memset(&sScanStats, 0, sizeof(sScanStats));
+	sRefreshXfer.isRead = 1;
+	sRefreshXfer.data = sRefreshRaw;
+	sRefreshXfer.callback = digin_refresh_done;
+	for (uint8_t i = 0; i < 8; i++){
+		sDebounce_ms[i] = OTD_DIGIN_DEBOUNCE_MS;
+	}
+	debounce_thresholds();
+	sIsDebounceStarted = 0;
+	sEventHead = 0;
+	sEventTail = 0;
+	sEventOverrunCount = 0;
+	memset(sCounter, 0, sizeof(sCounter));
+	sGateCountdown_ms = sGate_ms;
+	if (sIsHooked == 0){
+		if (otd_AddMsHook(digital_tick) == 0){
+			sIsHooked = 1;
+		}
+	}
 
 	/* Initialize Digital Output */
 	init_digital_output();
 
+	// First sample, so the readers need not read the bus before the first background scan
+	OTD_DIGIN_WORD tmpWord;
+	otd_DigitalScan(&tmpWord);
+
 	return;
 }
 
 uint8_t otd_DigitalRead(enum DIGITAL_INPUT_PINS inInputPin){
 
-	uint8_t tmpByte = otd_DigitalReadAll();
-	if (tmpByte & (1 << inInputPin)){
+	if (sSnapshot & (1 << inInputPin)){
 		return 1;
 	}
 
 	return 0;
 };
 
+// Gives the last good sample if the device does not answer. Use otd_DigitalTryRead() to see the status
 uint8_t otd_DigitalReadAll(){
 
-	uint8_t addrByte;
 	uint8_t valByte;
-	uint8_t retVal;
-
-	/*
-	 * ::: NOTE :::	We do not know the current state of the IC so, we send a "STOP" mark
-	 */
-	I2C_Stop();
-	I2C_Start();
-	addrByte = 0x40;
-	BIT_SET(addrByte,0);
-	retVal = I2C_Write_Byte(addrByte);
-	if (retVal == 0){
-		otd_UartPrintln("NO ACK !!!");
-		I2C_Stop();
-		return 0;
+
+	if (otd_DigitalTryRead(&valByte) != OTD_I2C_OK){
+		return sSnapshot;
 	}
-	// Read port of the device
-	I2C_Read_Byte(&valByte);
-	I2C_Stop();
 
-	// Due to the input interface IC, digital input LSB is sent first. So, reverse input byte
-	valByte = reverse_bit8(valByte);
-	// Note that the input values are inverted due to the digital input circuitry
-	return ~valByte;
+	return valByte;
 };
 
 
-void otd_DigitalWrite(enum DIGITAL_OUTPUT_PINS inOutputPin, uint8_t inValue){
+int8_t otd_DigitalTryRead(uint8_t *outInputs){
+
+	uint8_t valByte;
+
+	// Read port of the device. Retries and bus recovery are done by otd_I2c
+	int8_t tmpStatus = otd_I2cRead(DIGIN_I2C_ADDR, &valByte, 1);
+	if (tmpStatus == OTD_I2C_OK){
+		// Note that the input values are inverted due to the digital input circuitry
+		*outInputs = ~valByte;
+	}
+
+	return tmpStatus;
+}
+
+
+// Reads the inputs now, for a sample of a known moment. The snapshot is kept if the read fails
+uint8_t otd_DigitalLatch(){
+
+	uint8_t tmpByte;
+
+	if (otd_DigitalTryRead(&tmpByte) != OTD_I2C_OK){
+		return sSnapshot;
+	}
+	uint32_t tmpTime_ms = getUptime_ms();
+
+	uint8_t oldSREG = SREG;
+	cli();
+	sSnapshot = tmpByte;
+	sSnapshotTime_ms = tmpTime_ms;
+	sIsSnapshotValid = 1;
+	sScanBytes[0] = tmpByte;
+	SREG = oldSREG;
+
+	return tmpByte;
+}
+
+
+
+// Milliseconds since the last good sample, 0xFFFFFFFF if there was none
+uint32_t otd_DigitalGetSampleAge_ms(){
+
+	uint32_t tmpTime_ms;
+
+	uint8_t oldSREG = SREG;
+	cli();
+	if (sIsSnapshotValid == 0){
+		SREG = oldSREG;
+		return 0xFFFFFFFF;
+	}
+	tmpTime_ms = sSnapshotTime_ms;
+	SREG = oldSREG;
+
+	return getUptime_ms() - tmpTime_ms;
+}
+
+
+
+// Returns the last sampled inputs without reading the bus. "outTime_ms" is the uptime of the sample, 0 if none
+uint8_t otd_DigitalGetSnapshot(uint32_t *outTime_ms){
 
-	volatile uint8_t *curPort;
-	uint8_t curPin;
-
-	switch(inOutputPin){
-	case DIGITAL_OUTPUT_1:
-		curPort = &PORTB;
-		curPin = 7;
-		break;
-
-	case DIGITAL_OUTPUT_2:
-		curPort = &PORTB;
-		curPin = 0;
-		break;
-
-	case DIGITAL_OUTPUT_3:
-		curPort = &PORTB;
-		curPin = 2;
-		break;
-
-	case DIGITAL_OUTPUT_4:
-		curPort = &PORTB;
-		curPin = 3;
-		break;
-
-	case DIGITAL_OUTPUT_5:
-		curPort = &PORTD;
-		curPin = 6;
-		break;
-
-	case DIGITAL_OUTPUT_6:
-		curPort = &PORTD;
-		curPin = 3;
-		break;
-
-	default:
+	uint8_t tmpByte;
+
+	uint8_t oldSREG = SREG;
+	cli();
+	tmpByte = sSnapshot;
+	if (outTime_ms != 0){
+		*outTime_ms = sSnapshotTime_ms;
+	}
+	SREG = oldSREG;
+
+	return tmpByte;
+}
+
+
+
+void otd_DigitalSetRefresh(uint16_t inPeriod_ms){
+
+	uint8_t oldSREG = SREG;
+	cli();
+	sRefreshPeriod_ms = inPeriod_ms;
+	sRefreshCountdown_ms = 1;
+	// Same debounce time is a different sample count now
+	debounce_thresholds();
+	SREG = oldSREG;
+
+	return;
+}
+
+
+
+void otd_DigitalSetDebounce(enum DIGITAL_INPUT_PINS inInputPin, uint16_t inTime_ms){
+
+	if (inInputPin > DIGITAL_INPUT_8){
 		return;
 	}
 
-	// Set pin value
-	if (inValue == 0){
-		*curPort &= ~(1 << curPin);
-	}else{
-		*curPort |= (1 << curPin);
+	uint8_t oldSREG = SREG;
+	cli();
+	sDebounce_ms[inInputPin] = inTime_ms;
+	debounce_thresholds();
+	SREG = oldSREG;
+
+	return;
+}
+
+
+
+uint8_t otd_DigitalReadDebounced(){
+	return sDebounced;
+}
+
+
+
+// Returns 0 and the oldest event, or -1 when there is none
+int8_t otd_DigitalGetEvent(struct OTD_DIGIN_EVENT *outEvent){
+
+	uint8_t tmpTail = sEventTail;
+
+	if (tmpTail == sEventHead){
+		return -1;
+	}
+	// Queue is not volatile, copy the event only after the head is seen
+	__asm__ __volatile__("" ::: "memory");
+	*outEvent = sEventQueue[tmpTail];
+	// Free the slot after it is copied
+	__asm__ __volatile__("" ::: "memory");
+	sEventTail = (tmpTail + 1) & (OTD_DIGIN_EVENT_QUEUE_SIZE - 1);
+
+	return 0;
+}
+
+
+
+void otd_DigitalSetGate(uint16_t inGate_ms){
+
+	if (inGate_ms == 0){
+		return;
 	}
 
+	uint8_t oldSREG = SREG;
+	cli();
+	sGate_ms = inGate_ms;
+	sGateCountdown_ms = inGate_ms;
+	SREG = oldSREG;
+
 	return;
 }
 
 
 
-uint8_t otd_GetDigitalWriteState(enum DIGITAL_OUTPUT_PINS inOutputPin){
+int8_t otd_DigitalGetCount(enum DIGITAL_INPUT_PINS inInputPin, struct OTD_DIGIN_COUNT *outCount){
+
+	struct digin_counter tmpCounter;
+
+	if (inInputPin >= OTD_DIGIN_COUNTER_COUNT){
+		memset(outCount, 0, sizeof(struct OTD_DIGIN_COUNT));
+		return -1;
+	}
+
+	uint8_t oldSREG = SREG;
+	cli();
+	tmpCounter = sCounter[inInputPin];
+	SREG = oldSREG;
+
+	// Divisions are done here, not in the interrupt
+	outCount->count = tmpCounter.count;
+	outCount->lastEdge_ms = tmpCounter.lastEdge_ms;
+	outCount->period_ms = (tmpCounter.count < 2) ? 0 : tmpCounter.lastEdge_ms - tmpCounter.prevEdge_ms;
+	outCount->gateCount = tmpCounter.resultEdges;
+	outCount->freq_mHz = 0;
+	if (tmpCounter.resultEdges >= 2 && tmpCounter.resultSpan_ms != 0){
+		uint32_t tmpIntervals = tmpCounter.resultEdges - 1;
+		if (tmpIntervals <= 0xFFFFFFFFUL / 1000000UL){
+			outCount->freq_mHz = (tmpIntervals * 1000000UL) / tmpCounter.resultSpan_ms;
+		}else{
+			outCount->freq_mHz = ((tmpIntervals * 1000UL) / tmpCounter.resultSpan_ms) * 1000UL;
+		}
+	}
 
-	uint8_t curPort;
-	uint8_t curPin;
-
-	switch(inOutputPin){
-	case DIGITAL_OUTPUT_1:
-		curPort = PORTB;
-		curPin = 7;
-		break;
-
-	case DIGITAL_OUTPUT_2:
-		curPort = PORTB;
-		curPin = 0;
-		break;
-
-	case DIGITAL_OUTPUT_3:
-		curPort = PORTB;
-		curPin = 2;
-		break;
-
-	case DIGITAL_OUTPUT_4:
-		curPort = PORTB;
-		curPin = 3;
-		break;
-
-	case DIGITAL_OUTPUT_5:
-		curPort = PORTD;
-		curPin = 6;
-		break;
-
-	case DIGITAL_OUTPUT_6:
-		curPort = PORTD;
-		curPin = 3;
-		break;
-
-	default:
+	return 0;
+}
+
+
+
+void otd_DigitalResetCount(enum DIGITAL_INPUT_PINS inInputPin){
+
+	if (inInputPin >= OTD_DIGIN_COUNTER_COUNT){
+		return;
+	}
+
+	uint8_t oldSREG = SREG;
+	cli();
+	memset(&sCounter[inInputPin], 0, sizeof(struct digin_counter));
+	SREG = oldSREG;
+
+	return;
+}
+
+
+
+uint16_t otd_DigitalGetEventOverrunCount(){
+
+	uint16_t tmpCount;
+
+	uint8_t oldSREG = SREG;
+	cli();
+	tmpCount = sEventOverrunCount;
+	SREG = oldSREG;
+
+	return tmpCount;
+}
+
+
+
+int8_t otd_DigitalReadAsync(uint8_t *outInputs){
+
+	if (sIsInputStarted == 0){
+		sInputXfer.addr = DIGIN_I2C_ADDR;
+		sInputXfer.isRead = 1;
+		sInputXfer.length = 1;
+		sInputXfer.data = &sInputByte;
+		sInputXfer.callback = 0;
+		// Try again on the next call if the queue is full
+		if (otd_I2cSubmit(&sInputXfer) == 0){
+			sIsInputStarted = 1;
+		}
+		return OTD_I2C_PENDING;
+	}
+
+	int8_t tmpStatus = sInputXfer.status;
+	if (tmpStatus == OTD_I2C_PENDING){
+		return tmpStatus;
+	}
+	sIsInputStarted = 0;
+	if (tmpStatus == OTD_I2C_OK){
+		*outInputs = ~sInputByte;
+	}
+
+	return tmpStatus;
+}
+
+
+// Returns the number of its first input, or -1 if the table or the input word is full
+int8_t otd_DigitalAddDevice(const struct OTD_DIGIN_DEVICE *inDevice){
+
+	int8_t retVal = -1;
+
+	if (inDevice->width == 0 || inDevice->width > DIGIN_DEVICE_WIDTH_MAX || inDevice->addr > 0x7F){
+		return -1;
+	}
+
+	uint8_t oldSREG = SREG;
+	cli();
+	if (sDeviceCount < OTD_DIGIN_DEVICE_MAX && sInputByteCount + inDevice->width <= OTD_DIGIN_INPUT_BYTES){
+		sDevice[sDeviceCount] = *inDevice;
+		sDeviceCount = sDeviceCount + 1;
+		retVal = sInputByteCount * 8;
+		sInputByteCount = sInputByteCount + inDevice->width;
+	}
+	SREG = oldSREG;
+
+	return retVal;
+}
+
+
+
+// Reads all expanders now in one bus session. Returns the first error, "outInputs" is set anyway
+int8_t otd_DigitalScan(OTD_DIGIN_WORD *outInputs){
+
+	struct OTD_I2C_XFER tmpXfer[OTD_DIGIN_DEVICE_MAX];
+	uint8_t tmpRaw[OTD_DIGIN_INPUT_BYTES];
+	uint8_t tmpCount = sDeviceCount;
+	uint8_t tmpOffset = 0;
+
+	for (uint8_t i = 0; i < tmpCount; i++){
+		tmpXfer[i].addr = sDevice[i].addr;
+		tmpXfer[i].isRead = 1;
+		tmpXfer[i].length = sDevice[i].width;
+		tmpXfer[i].data = &tmpRaw[tmpOffset];
+		tmpXfer[i].callback = 0;
+		tmpOffset = tmpOffset + sDevice[i].width;
+	}
+
+	uint32_t tmpStart_us = getUptime_us();
+	int8_t tmpStatus = otd_I2cTransfer(tmpXfer, tmpCount);
+	uint32_t tmpTime_us = getUptime_us() - tmpStart_us;
+	uint32_t tmpTime_ms = getUptime_ms();
+
+	uint8_t oldSREG = SREG;
+	cli();
+	tmpOffset = 0;
+	for (uint8_t i = 0; i < tmpCount; i++){
+		if (tmpXfer[i].status == OTD_I2C_OK){
+			scan_store(i, tmpOffset, &tmpRaw[tmpOffset], tmpTime_ms);
+		}
+		tmpOffset = tmpOffset + sDevice[i].width;
+	}
+	scan_record(tmpStatus, tmpTime_us, tmpTime_ms);
+	*outInputs = scan_word();
+	SREG = oldSREG;
+
+	return tmpStatus;
+}
+
+
+
+// Returns the last scanned inputs. "outTime_ms" is the uptime of the scan, it may be 0
+OTD_DIGIN_WORD otd_DigitalReadWide(uint32_t *outTime_ms){
+
+	OTD_DIGIN_WORD tmpWord;
+
+	uint8_t oldSREG = SREG;
+	cli();
+	tmpWord = scan_word();
+	if (outTime_ms != 0){
+		*outTime_ms = sScanTime_ms;
+	}
+	SREG = oldSREG;
+
+	return tmpWord;
+}
+
+
+
+// Input number in the word, from 0
+uint8_t otd_DigitalReadInput(uint8_t inInput){
+
+	if (inInput >= sInputByteCount * 8){
 		return 0;
 	}
 
-	// Get output pin state
-	if (curPort & (1 << curPin)){
+	if (sScanBytes[inInput >> 3] & (1 << (inInput & 7))){
 		return 1;
 	}
 
@@ -198,6 +556,120 @@ uint8_t otd_GetDigitalWriteState(enum DIGITAL_OUTPUT_PINS inOutputPin){
 }
 
 
+
+void otd_DigitalGetScanStats(struct OTD_DIGIN_SCAN_STATS *outStats){
+
+	uint8_t oldSREG = SREG;
+	cli();
+	*outStats = sScanStats;
+	SREG = oldSREG;
+	outStats->deviceCount = sDeviceCount;
+
+	return;
+}
+
+
+void otd_DigitalResetScanStats(){
+
+	uint8_t oldSREG = SREG;
+	cli();
+	memset(&sScanStats, 0, sizeof(sScanStats));
+	SREG = oldSREG;
+
+	return;
+}
+
+
+
+void otd_DigitalWrite(enum DIGITAL_OUTPUT_PINS inOutputPin, uint8_t inValue){
+
+	if (inOutputPin >= DIGITAL_OUTPUT_COUNT){
+		return;
+	}
+
+	otd_DigitalWriteMask(1 << inOutputPin, (inValue == 0) ? 0 : 0xFF);
+
+	return;
+}
+
+
+
+void otd_DigitalWriteMask(uint8_t inMask, uint8_t inValues){
+
+	struct digout_bits tmpBits;
+
+	// Port bits are collected first, so the masked section is short
+	digout_collect(inMask, inValues, &tmpBits);
+
+	uint8_t oldSREG = SREG;
+	cli();
+	OTD_PROFILE_CLI_BEGIN();
+	sTimedMask &= ~inMask;
+	digout_write(&tmpBits, inMask, inValues);
+	OTD_PROFILE_CLI_END();
+	SREG = oldSREG;
+
+	return;
+}
+
+
+
+uint8_t otd_GetDigitalWriteState(enum DIGITAL_OUTPUT_PINS inOutputPin){
+
+	if (inOutputPin >= DIGITAL_OUTPUT_COUNT){
+		return 0;
+	}
+	if (sOutputShadow & (1 << inOutputPin)){
+		return 1;
+	}
+
+	return 0;
+}
+
+
+
+uint8_t otd_DigitalReadOutputs(){
+	return sOutputShadow;
+}
+
+
+// Duty 0 keeps the output off, 1000 keeps it on
+int8_t otd_DigitalSetPwm(enum DIGITAL_OUTPUT_PINS inOutputPin, uint16_t inPeriod_ms, uint16_t inDuty_pm){
+
+	if (inDuty_pm > 1000){
+		return -1;
+	}
+
+	uint16_t tmpOn_ms = ((uint32_t)inPeriod_ms * inDuty_pm + 500) / 1000;
+
+	return digout_start(inOutputPin, inPeriod_ms, tmpOn_ms, 0);
+}
+
+
+
+int8_t otd_DigitalBlink(enum DIGITAL_OUTPUT_PINS inOutputPin, uint16_t inOn_ms, uint16_t inOff_ms, uint16_t inCount){
+
+	if ((uint32_t)inOn_ms + inOff_ms > 0xFFFF){
+		return -1;
+	}
+
+	return digout_start(inOutputPin, inOn_ms + inOff_ms, inOn_ms, inCount);
+}
+
+
+
+int8_t otd_DigitalPulse(enum DIGITAL_OUTPUT_PINS inOutputPin, uint16_t inOn_ms){
+	return digout_start(inOutputPin, inOn_ms, inOn_ms, 1);
+}
+
+
+
+uint8_t otd_DigitalGetTimedMask(){
+	return sTimedMask;
+}
+
+
+
 void otd_OutputEnable(){
 	PORTD |= (1 << DIGOUT_EN_PIN);
 	return;
@@ -210,191 +682,396 @@ void otd_OutputDisable(){
 }
 
 
-static uint8_t reverse_bit8(uint8_t x)
-{
-	x = ((x & 0x55) << 1) | ((x & 0xAA) >> 1);
-	x = ((x & 0x33) << 2) | ((x & 0xCC) >> 2);
-	return (x << 4) | (x >> 4);
-}
+/*
+ * DIGITAL INPUT Functions
+ */
+// Called from the tick interrupt on every millisecond
+static void digital_tick(){
 
+	digout_tick();
+	digin_tick();
 
+	return;
+}
 
 
-/*
- * I2C Functions
- */
-/* The connection of the 2-wire interface is related to the actual circuit */
-#define I2C_SCL_PORT_DIR		DDRE
-#define I2C_SCL_PORT_OUT		PORTE
-//#define I2C_SCL_PORT_IN			PIND
-#define I2C_SCL_PIN				3
-//
-#define I2C_SDA_PORT_DIR		DDRD
-#define I2C_SDA_PORT_OUT		PORTD
-#define I2C_SDA_PORT_IN			PIND
-#define I2C_SDA_PIN				7
-/* The bit operation of the 2-wire interface is related to the microcontroller */
-#define I2C_SCL_SET				(I2C_SCL_PORT_OUT |= (1 << I2C_SCL_PIN))
-#define I2C_SCL_CLR				(I2C_SCL_PORT_OUT &= ~(1 << I2C_SCL_PIN))
-#define I2C_SCL_D_OUT			(I2C_SCL_PORT_DIR |= (1 << I2C_SCL_PIN))
-//
-#define I2C_SDA_SET				(I2C_SDA_PORT_OUT |= (1 << I2C_SDA_PIN))
-#define I2C_SDA_CLR				(I2C_SDA_PORT_OUT &= ~(1 << I2C_SDA_PIN))
-#define I2C_SDA_IN				(I2C_SDA_PORT_IN & (1 << I2C_SDA_PIN))
-#define I2C_SDA_D_OUT			(I2C_SDA_PORT_DIR |= (1 << I2C_SDA_PIN))\
-// ::: NOTE :::	Setting SDA while it is input, sets the internal pull up resistor
-#define I2C_SDA_D_IN			{(I2C_SDA_PORT_DIR &= ~(1 << I2C_SDA_PIN));(I2C_SDA_SET);}
-//
-#define I2C_DELAY 5   // uS
+static void digin_tick(){
 
+	sGateCountdown_ms = sGateCountdown_ms - 1;
+	if (sGateCountdown_ms == 0){
+		sGateCountdown_ms = sGate_ms;
+		counter_gate();
+	}
 
-static void I2C_Init(){
+	if (sRefreshPeriod_ms == 0){
+		return;
+	}
+	sRefreshCountdown_ms = sRefreshCountdown_ms - 1;
+	if (sRefreshCountdown_ms != 0){
+		return;
+	}
+	sRefreshCountdown_ms = sRefreshPeriod_ms;
 
-	I2C_SCL_SET;		// Set SCL high
-	I2C_SCL_D_OUT;		// Set SCL as output
-	I2C_SDA_SET;		// Set SDA high
-	I2C_SDA_D_OUT;		// Set SDA as output
+	// Skip this period if the last scan is still running or the queue is full
+	if (sRefreshXfer.status != OTD_I2C_PENDING){
+		scan_start();
+	}
 
 	return;
 }
 
-static void I2C_Start()
-{
-   I2C_SDA_D_OUT;
-   I2C_SCL_SET;      			//SCL  high;
-   _delay_us(I2C_DELAY);
-   I2C_SDA_SET;      			//SDA  high;
-   _delay_us(I2C_DELAY);
-   I2C_SDA_CLR;      			//SDA  low;
-   _delay_us(I2C_DELAY);
-   I2C_SCL_CLR;      			//SCL  low;
-   _delay_us(I2C_DELAY);
-   return;
-}
-
-static void I2C_Stop()
-{
-	I2C_SDA_D_OUT;
-	I2C_SCL_CLR;
-	_delay_us(I2C_DELAY);
-   I2C_SDA_CLR;
-   _delay_us(I2C_DELAY);
-   I2C_SCL_SET;
-   _delay_us(I2C_DELAY);
-   I2C_SDA_SET;
-   _delay_us(I2C_DELAY);
-
-   return;
-}
-
-static uint8_t I2C_Write_Byte(unsigned char inByte)
-{
-	// We reset hasAck if the slave does not send ACK
-	unsigned char hasACK = 1;
-
-	unsigned char i;
-	I2C_SDA_D_OUT;
-	for(i = 0; i < 8; i++) {
-		if(inByte & 0x80){
-			I2C_SDA_SET;
-		}else{
-			I2C_SDA_CLR;
+
+// Called from the tick interrupt when the background read of a device completes
+static void digin_refresh_done(struct OTD_I2C_XFER *inXfer){
+
+	uint32_t tmpTime_ms = getUptime_ms();
+
+	if (inXfer->status == OTD_I2C_OK){
+		scan_store(sScanDevice, sScanOffset, sRefreshRaw, tmpTime_ms);
+		if (sScanDevice == 0){
+			debounce_sample(sScanBytes[0], tmpTime_ms);
 		}
-		_delay_us(I2C_DELAY);
-		I2C_SCL_SET;
-		_delay_us(I2C_DELAY);
-		I2C_SCL_CLR;
-		_delay_us(I2C_DELAY);
-		inByte<<=1;
+	}else if (sScanStatus == OTD_I2C_OK){
+		sScanStatus = inXfer->status;
 	}
-	_delay_us(I2C_DELAY);
 
-	I2C_SDA_D_IN;
-	_delay_us(I2C_DELAY);
-	I2C_SCL_SET;
-	_delay_us(I2C_DELAY);
+	// Next device right away, a queue slot was just freed for it
+	sScanOffset = sScanOffset + sDevice[sScanDevice].width;
+	sScanDevice = sScanDevice + 1;
+	if (sScanDevice < sDeviceCount){
+		if (scan_submit() == 0){
+			return;
+		}
+		// Rest of the devices are not read in this scan
+		if (sScanStatus == OTD_I2C_OK){
+			sScanStatus = OTD_I2C_QUEUE_FULL;
+		}
+	}
+	scan_record(sScanStatus, getUptime_us() - sScanStart_us, tmpTime_ms);
 
-	// Read the Acknowledge bit
-	if (I2C_SDA_IN != 0){
-		// Could not get acknowledge
-		hasACK = 0;
+	return;
+}
+
+
+// Called from the tick interrupt
+static void scan_start(){
+
+	sScanDevice = 0;
+	sScanOffset = 0;
+	sScanStatus = OTD_I2C_OK;
+	sScanStart_us = getUptime_us();
+	if (scan_submit() != 0){
+		// Nothing is read, the scan time stays at the last scan
+		sScanStatus = OTD_I2C_QUEUE_FULL;
+		scan_record(sScanStatus, 0, sScanTime_ms);
 	}
 
-	I2C_SCL_CLR;
-	_delay_us(I2C_DELAY);
+	return;
+}
+
+
+// Call with interrupts masked
+static int8_t scan_submit(){
+
+	sRefreshXfer.addr = sDevice[sScanDevice].addr;
+	sRefreshXfer.length = sDevice[sScanDevice].width;
+
+	return otd_I2cSubmit(&sRefreshXfer);
+}
+
+
+// Call with interrupts masked. Keeps the good inputs of a device
+static void scan_store(uint8_t inDevice, uint8_t inOffset, const uint8_t *inRaw, uint32_t inTime_ms){
+
+	for (uint8_t i = 0; i < sDevice[inDevice].width; i++){
+		sScanBytes[inOffset + i] = (sDevice[inDevice].isInverted) ? ~inRaw[i] : inRaw[i];
+	}
+	if (inDevice == 0){
+		// On-board inputs, see otd_DigitalLatch()
+		sSnapshot = sScanBytes[0];
+		sSnapshotTime_ms = inTime_ms;
+		sIsSnapshotValid = 1;
+	}
 
-	return hasACK;
+	return;
 }
 
-static void I2C_Read_Byte(uint8_t *outByte){
 
-	// Reset output byte
-	*outByte = 0;
-	unsigned char i, bytedata=0;
+// Call with interrupts masked
+static void scan_record(int8_t inStatus, uint32_t inTime_us, uint32_t inTime_ms){
 
-	//Set the data to input mode
-	I2C_SDA_D_IN;
-	_delay_us(I2C_DELAY);
+	sScanTime_ms = inTime_ms;
+	sScanStats.scanCount = sScanStats.scanCount + 1;
+	if (inStatus != OTD_I2C_OK){
+		sScanStats.failCount = sScanStats.failCount + 1;
+	}
+	sScanStats.lastStatus = inStatus;
+	sScanStats.last_us = inTime_us;
+	if (inTime_us > sScanStats.max_us){
+		sScanStats.max_us = inTime_us;
+	}
 
-	//The data line is pulled high
-	I2C_SDA_SET;
-	_delay_us(I2C_DELAY);
-	I2C_SCL_CLR;
-	_delay_us(I2C_DELAY);
+	return;
+}
 
-	//Read 8-bit data
-	for(i = 0; i <8; i++){
-		I2C_SCL_SET;
-		_delay_us(I2C_DELAY);
-		_delay_us(I2C_DELAY);
-		if (I2C_SDA_IN){
-			bytedata |= (1 << i);
-		}else{
-			bytedata &= ~(1 << i);
+
+// Call with interrupts masked. First device is in the lowest bits
+static OTD_DIGIN_WORD scan_word(){
+
+	OTD_DIGIN_WORD tmpWord = 0;
+
+	for (uint8_t i = sInputByteCount; i > 0; i--){
+		tmpWord = (tmpWord << 8) | sScanBytes[i - 1];
+	}
+
+	return tmpWord;
+}
+
+
+// Call with interrupts masked
+static void debounce_thresholds(){
+
+	for (uint8_t k = 0; k < DEBOUNCE_BITS; k++){
+		sThreshold[k] = 0;
+	}
+	for (uint8_t i = 0; i < 8; i++){
+		// Whole samples, rounded up
+		uint16_t tmpSamples = 1;
+		if (sRefreshPeriod_ms != 0){
+			tmpSamples = (sDebounce_ms[i] + sRefreshPeriod_ms - 1) / sRefreshPeriod_ms;
+		}
+		if (tmpSamples == 0){
+			tmpSamples = 1;
+		}else if (tmpSamples > DEBOUNCE_MAX){
+			tmpSamples = DEBOUNCE_MAX;
+		}
+		for (uint8_t k = 0; k < DEBOUNCE_BITS; k++){
+			if (tmpSamples & (1 << k)){
+				sThreshold[k] |= (1 << i);
+			}
 		}
+	}
+
+	return;
+}
+
+
+// Called from the tick interrupt with every background sample
+static void debounce_sample(uint8_t inInputs, uint32_t inTime_ms){
 
-		_delay_us(I2C_DELAY);
-		I2C_SCL_CLR;
-		_delay_us(I2C_DELAY);
+	if (sIsDebounceStarted == 0){
+		// First sample is taken as it is, no events
+		sDebounced = inInputs;
+		for (uint8_t k = 0; k < DEBOUNCE_BITS; k++){
+			sCount[k] = 0;
+		}
+		sIsDebounceStarted = 1;
+		return;
 	}
 
-	//Set the data line back to output mode
-	I2C_SDA_D_OUT;
+	// Count the inputs which differ from the debounced state, clear the others
+	uint8_t tmpDiff = inInputs ^ sDebounced;
+	uint8_t tmpCarry = tmpDiff;
+	uint8_t tmpMismatch = 0;
+	for (uint8_t k = 0; k < DEBOUNCE_BITS; k++){
+		uint8_t tmpNext = sCount[k] & tmpCarry;
+		sCount[k] = (sCount[k] ^ tmpCarry) & tmpDiff;
+		tmpCarry = tmpNext;
+		tmpMismatch |= sCount[k] ^ sThreshold[k];
+	}
 
-	I2C_SDA_SET;
-	_delay_us(I2C_DELAY);
-	I2C_SCL_SET;
-	_delay_us(I2C_DELAY);
-	I2C_SCL_CLR;
-	_delay_us(I2C_DELAY);
+	// Inputs whose counter reached the threshold change now
+	uint8_t tmpChanged = ~tmpMismatch & tmpDiff;
+	if (tmpChanged == 0){
+		return;
+	}
+	sDebounced = sDebounced ^ tmpChanged;
+	for (uint8_t k = 0; k < DEBOUNCE_BITS; k++){
+		sCount[k] &= ~tmpChanged;
+	}
+	counter_edges(tmpChanged & inInputs, inTime_ms);
+
+	for (uint8_t i = 0; i < 8; i++){
+		if ((tmpChanged & (1 << i)) == 0){
+			continue;
+		}
+		uint8_t tmpHead = sEventHead;
+		uint8_t nextHead = (tmpHead + 1) & (OTD_DIGIN_EVENT_QUEUE_SIZE - 1);
+		if (nextHead == sEventTail){
+			sEventOverrunCount = sEventOverrunCount + 1;
+			continue;
+		}
+		sEventQueue[tmpHead].time_ms = inTime_ms;
+		sEventQueue[tmpHead].pin = i;
+		sEventQueue[tmpHead].isRising = (inInputs >> i) & 1;
+		// Publish the event after it is stored
+		__asm__ __volatile__("" ::: "memory");
+		sEventHead = nextHead;
+	}
+
+	return;
+}
+
+
+// Called from the tick interrupt with the inputs which rose in this sample
+static void counter_edges(uint8_t inRising, uint32_t inTime_ms){
+
+	for (uint8_t i = 0; i < OTD_DIGIN_COUNTER_COUNT; i++, inRising >>= 1){
+		if ((inRising & 1) == 0){
+			continue;
+		}
+		struct digin_counter *curCounter = &sCounter[i];
+		curCounter->count = curCounter->count + 1;
+		curCounter->prevEdge_ms = curCounter->lastEdge_ms;
+		curCounter->lastEdge_ms = inTime_ms;
+		if (curCounter->gateEdges == 0){
+			curCounter->gateFirstEdge_ms = inTime_ms;
+		}
+		if (curCounter->gateEdges != 0xFFFF){
+			curCounter->gateEdges = curCounter->gateEdges + 1;
+		}
+	}
+
+	return;
+}
+
+
+// Called from the tick interrupt at the end of every gate
+static void counter_gate(){
+
+	for (uint8_t i = 0; i < OTD_DIGIN_COUNTER_COUNT; i++){
+		struct digin_counter *curCounter = &sCounter[i];
+		curCounter->resultEdges = curCounter->gateEdges;
+		curCounter->resultSpan_ms = curCounter->lastEdge_ms - curCounter->gateFirstEdge_ms;
+		curCounter->gateEdges = 0;
+	}
 
-	*outByte = bytedata;
 	return;
 }
 
+
 /*
  * DIGITAL OUTPUT Functions
  */
 static void init_digital_output(){
 
+	uint8_t tmpMask[DIGOUT_PORT_COUNT] = {0, 0};
+
 	// Set output enable to zero and make the pin output
 	PORTD &= ~(1 << DIGOUT_EN_PIN);
 	DDRD |= (1 << DIGOUT_EN_PIN);
-	// Reset output
-	PORTB &= ~(1 << 7);		// OUT 0
-	PORTB &= ~(1 << 0);		// OUT 1
-	PORTB &= ~(1 << 2);		// OUT 2
-	PORTB &= ~(1 << 3);		// OUT 3
-	PORTD &= ~(1 << 6);		// OUT 4
-	PORTD &= ~(1 << 3);		// OUT 5
-
-	// Set as output
-	DDRB |= (1 << 7);
-	DDRB |= (1 << 0);
-	DDRB |= (1 << 2);
-	DDRB |= (1 << 3);
-	DDRD |= (1 << 6);
-	DDRD |= (1 << 3);
+
+	for (uint8_t i = 0; i < DIGITAL_OUTPUT_COUNT; i++){
+		tmpMask[pgm_read_byte(&sOutputPin[i].port)] |= pgm_read_byte(&sOutputPin[i].bit);
+	}
+
+	// Reset outputs, then set as output
+	uint8_t oldSREG = SREG;
+	cli();
+	PORTB &= ~tmpMask[DIGOUT_PORT_B];
+	PORTD &= ~tmpMask[DIGOUT_PORT_D];
+	sOutputShadow = 0;
+	sTimedMask = 0;
+	SREG = oldSREG;
+	DDRB |= tmpMask[DIGOUT_PORT_B];
+	DDRD |= tmpMask[DIGOUT_PORT_D];
+
+	return;
+}
+
+
+
+static void digout_collect(uint8_t inMask, uint8_t inValues, struct digout_bits *outBits){
+
+	memset(outBits, 0, sizeof(struct digout_bits));
+	for (uint8_t i = 0; i < DIGITAL_OUTPUT_COUNT; i++){
+		if ((inMask & (1 << i)) == 0){
+			continue;
+		}
+		uint8_t curPort = pgm_read_byte(&sOutputPin[i].port);
+		uint8_t curBit = pgm_read_byte(&sOutputPin[i].bit);
+		if (inValues & (1 << i)){
+			outBits->set[curPort] |= curBit;
+		}else{
+			outBits->clr[curPort] |= curBit;
+		}
+	}
+
+	return;
+}
+
+
+// Call with interrupts masked. PORTD is also written by the UART transmit interrupt
+static void digout_write(const struct digout_bits *inBits, uint8_t inMask, uint8_t inValues){
+
+	PORTB = (PORTB & ~inBits->clr[DIGOUT_PORT_B]) | inBits->set[DIGOUT_PORT_B];
+	PORTD = (PORTD & ~inBits->clr[DIGOUT_PORT_D]) | inBits->set[DIGOUT_PORT_D];
+	inMask &= (1 << DIGITAL_OUTPUT_COUNT) - 1;
+	sOutputShadow = (sOutputShadow & ~inMask) | (inValues & inMask);
+
+	return;
+}
+
+
+static int8_t digout_start(uint8_t inOutputPin, uint16_t inPeriod_ms, uint16_t inOn_ms, uint16_t inCount){
+
+	struct digout_bits tmpBits;
+
+	if (inOutputPin >= DIGITAL_OUTPUT_COUNT || inPeriod_ms == 0){
+		return -1;
+	}
+	digout_collect(1 << inOutputPin, (inOn_ms != 0) ? 0xFF : 0, &tmpBits);
+
+	uint8_t oldSREG = SREG;
+	cli();
+	sTimed[inOutputPin].period_ms = inPeriod_ms;
+	sTimed[inOutputPin].on_ms = inOn_ms;
+	sTimed[inOutputPin].phase_ms = 0;
+	sTimed[inOutputPin].count = inCount;
+	sTimedMask |= (1 << inOutputPin);
+	digout_write(&tmpBits, 1 << inOutputPin, (inOn_ms != 0) ? 0xFF : 0);
+	SREG = oldSREG;
+
+	return 0;
+}
+
+
+// Called from the tick interrupt on every millisecond
+static void digout_tick(){
+
+	uint8_t tmpMask = sTimedMask;
+	uint8_t tmpValues = 0;
+
+	if (tmpMask == 0){
+		return;
+	}
+
+	for (uint8_t i = 0; i < DIGITAL_OUTPUT_COUNT; i++){
+		if ((tmpMask & (1 << i)) == 0){
+			continue;
+		}
+		struct digout_timed *curTimed = &sTimed[i];
+		curTimed->phase_ms = curTimed->phase_ms + 1;
+		if (curTimed->phase_ms >= curTimed->period_ms){
+			curTimed->phase_ms = 0;
+			if (curTimed->count != 0){
+				curTimed->count = curTimed->count - 1;
+				if (curTimed->count == 0){
+					// Last cycle is over, the output stays off
+					sTimedMask &= ~(1 << i);
+					continue;
+				}
+			}
+		}
+		if (curTimed->phase_ms < curTimed->on_ms){
+			tmpValues |= (1 << i);
+		}
+	}
+
+	// All timed outputs in one write
+	struct digout_bits tmpBits;
+	digout_collect(tmpMask, tmpValues, &tmpBits);
+	digout_write(&tmpBits, tmpMask, tmpValues);
 
 	return;
 }
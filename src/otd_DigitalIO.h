@@ -24,6 +24,42 @@ extern "C"{
 #endif 
 
 #include <stdint.h>
+#include "otd_I2c.h"
+
+
+// Inputs are read in the background with this period. Zero leaves it to otd_DigitalLatch()
+#ifndef OTD_DIGIN_REFRESH_MS
+#define OTD_DIGIN_REFRESH_MS	10
+#endif
+// Debounce time of every input until otd_DigitalSetDebounce() is called
+#ifndef OTD_DIGIN_DEBOUNCE_MS
+#define OTD_DIGIN_DEBOUNCE_MS	20
+#endif
+// Edge events waiting for the application, must be a power of 2
+#ifndef OTD_DIGIN_EVENT_QUEUE_SIZE
+#define OTD_DIGIN_EVENT_QUEUE_SIZE	8
+#endif
+// Edges are counted on DIGITAL_INPUT_1 up to this many inputs, 24 bytes each
+#ifndef OTD_DIGIN_COUNTER_COUNT
+#define OTD_DIGIN_COUNTER_COUNT		4
+#endif
+// Gate time of the rate and the frequency
+#ifndef OTD_DIGIN_GATE_MS
+#define OTD_DIGIN_GATE_MS		1000
+#endif
+// Input expanders on the I2C bus, the on-board one included
+#ifndef OTD_DIGIN_DEVICE_MAX
+#define OTD_DIGIN_DEVICE_MAX		4
+#endif
+// Inputs of all expanders, 8 per byte. Up to 4 bytes give a 32 bit input word, more a 64 bit one
+#ifndef OTD_DIGIN_INPUT_BYTES
+#define OTD_DIGIN_INPUT_BYTES		4
+#endif
+#if OTD_DIGIN_INPUT_BYTES <= 4
+#define OTD_DIGIN_WORD		uint32_t
+#else
+#define OTD_DIGIN_WORD		uint64_t
+#endif
 
 enum DIGITAL_INPUT_PINS{
 	DIGITAL_INPUT_1 = 0,
@@ -36,22 +72,122 @@ enum DIGITAL_INPUT_PINS{
 	DIGITAL_INPUT_8
 };
 
+/*
+ * ::: NOTE :::	Expanders are read without a register address, like PCF8574 (8 inputs) and PCF8575 (16 inputs).
+ * 				Their inputs follow the on-board ones in the input word, in the order they are added.
+ */
+struct OTD_DIGIN_DEVICE {
+	uint8_t addr;					// 7 bits
+	uint8_t width;					// Input bytes, 1 or 2
+	uint8_t isInverted;				// Inputs read low when they are on
+};
+
+struct OTD_DIGIN_SCAN_STATS {
+	uint32_t scanCount;
+	uint16_t failCount;				// Scans with at least one device not read
+	int8_t lastStatus;				// First error of the last scan, OTD_I2C_STATUS
+	uint8_t deviceCount;
+	uint32_t last_us;				// Last scan, from its start to the stop mark of the last device
+	uint32_t max_us;
+};
+
+struct OTD_DIGIN_EVENT {
+	uint32_t time_ms;				// Uptime of the sample which confirmed the edge
+	uint8_t pin;					// DIGITAL_INPUT_PINS
+	uint8_t isRising;
+};
+
+struct OTD_DIGIN_COUNT {
+	uint32_t count;					// Rising edges since reset
+	uint32_t lastEdge_ms;			// Uptime of the last rising edge
+	uint32_t period_ms;				// Between the last two rising edges, 0 before the second one
+	uint16_t gateCount;				// Rising edges in the last complete gate
+	uint32_t freq_mHz;				// From the edge times in the last gate, 0 if it had less than 2 edges
+};
+
 enum DIGITAL_OUTPUT_PINS{
 	DIGITAL_OUTPUT_1 = 0,
 	DIGITAL_OUTPUT_2,
 	DIGITAL_OUTPUT_3,
 	DIGITAL_OUTPUT_4,
 	DIGITAL_OUTPUT_5,
-	DIGITAL_OUTPUT_6
+	DIGITAL_OUTPUT_6,
+	DIGITAL_OUTPUT_COUNT
 };
 
 
 
 void otd_InitDigitalIO();
+/*
+ * ::: NOTE :::	otd_DigitalRead() looks up the snapshot, which is refreshed in the background. It is at most
+ * 				"refresh period + 2.6ms" old. otd_DigitalLatch() reads the inputs now and updates the snapshot.
+ * 				otd_DigitalReadAll() reads the inputs now and leaves the snapshot as it is.
+ * 				If the device does not answer, the snapshot keeps the last good sample. otd_DigitalTryRead()
+ * 				returns the OTD_I2C_STATUS, otd_DigitalGetSampleAge_ms() tells how old the last good sample is.
+ * 				The first sample is read in otd_InitDigitalIO(), the snapshot readers never touch the bus. If
+ * 				that read fails, the snapshot is 0 with time 0 until a background scan succeeds.
+ */
 uint8_t otd_DigitalRead(enum DIGITAL_INPUT_PINS inInputPin);
 uint8_t otd_DigitalReadAll();
+int8_t otd_DigitalTryRead(uint8_t *outInputs);
+uint8_t otd_DigitalLatch();
+uint8_t otd_DigitalGetSnapshot(uint32_t *outTime_ms);
+uint32_t otd_DigitalGetSampleAge_ms();
+void otd_DigitalSetRefresh(uint16_t inPeriod_ms);
+/*
+ * ::: NOTE :::	Debounce runs on the background samples. An input changes after it is stable for the debounce
+ * 				time, rounded up to whole refresh periods (1..15 samples). All 8 inputs are counted together
+ * 				with a 4 bit vertical counter. Every change is queued as an edge event.
+ */
+void otd_DigitalSetDebounce(enum DIGITAL_INPUT_PINS inInputPin, uint16_t inTime_ms);
+uint8_t otd_DigitalReadDebounced();
+int8_t otd_DigitalGetEvent(struct OTD_DIGIN_EVENT *outEvent);
+uint16_t otd_DigitalGetEventOverrunCount();
+/*
+ * ::: NOTE :::	Counters take the rising edges of the debounced inputs. Edge times are the sample times, so
+ * 				they are quantized to the refresh period. Frequency is "(edges - 1) / (last - first edge)"
+ * 				within a gate, which is finer than "edges / gate" for slow signals. The highest rate is
+ * 				one pulse per 2 debounce times. Use a 1 sample debounce for clean sensor signals.
+ */
+void otd_DigitalSetGate(uint16_t inGate_ms);
+int8_t otd_DigitalGetCount(enum DIGITAL_INPUT_PINS inInputPin, struct OTD_DIGIN_COUNT *outCount);
+void otd_DigitalResetCount(enum DIGITAL_INPUT_PINS inInputPin);
+/*
+ * ::: NOTE :::	Non-blocking read: the first call starts it in the background and returns OTD_I2C_PENDING.
+ * 				Call again later, it returns OTD_I2C_OK with "outInputs" set, or an error status.
+ */
+int8_t otd_DigitalReadAsync(uint8_t *outInputs);
+/*
+ * ::: NOTE :::	All expanders are read back-to-back, in the background with the refresh period or at once with
+ * 				otd_DigitalScan(). A device which does not answer keeps its last good inputs in the word.
+ * 				In the background a scan takes about 2.6ms per 8 input device at the standard speed, keep the
+ * 				refresh period longer. Debounce, events and counters stay on the on-board inputs.
+ */
+int8_t otd_DigitalAddDevice(const struct OTD_DIGIN_DEVICE *inDevice);
+int8_t otd_DigitalScan(OTD_DIGIN_WORD *outInputs);
+OTD_DIGIN_WORD otd_DigitalReadWide(uint32_t *outTime_ms);
+uint8_t otd_DigitalReadInput(uint8_t inInput);
+void otd_DigitalGetScanStats(struct OTD_DIGIN_SCAN_STATS *outStats);
+void otd_DigitalResetScanStats();
+/*
+ * ::: NOTE :::	Bit n of a mask is DIGITAL_OUTPUT_n+1. otd_DigitalWriteMask() changes the outputs in "inMask" to
+ * 				their bits in "inValues", with one write per port: outputs on the same port change together.
+ * 				Write states are read back from a shadow copy, not from the ports.
+ */
 void otd_DigitalWrite(enum DIGITAL_OUTPUT_PINS inOutputPin, uint8_t inValue);
+void otd_DigitalWriteMask(uint8_t inMask, uint8_t inValues);
 uint8_t otd_GetDigitalWriteState(enum DIGITAL_OUTPUT_PINS inOutputPin);
+uint8_t otd_DigitalReadOutputs();
+/*
+ * ::: NOTE :::	Timed outputs run in the background on every millisecond, all of them with one masked write.
+ * 				Each output starts on at the call. Duty is in per mille of the period. Blinks and pulses turn
+ * 				the output off after their last cycle, "inCount" 0 blinks until stopped. otd_DigitalWrite()
+ * 				and otd_DigitalWriteMask() stop the timing of the outputs they write.
+ */
+int8_t otd_DigitalSetPwm(enum DIGITAL_OUTPUT_PINS inOutputPin, uint16_t inPeriod_ms, uint16_t inDuty_pm);
+int8_t otd_DigitalBlink(enum DIGITAL_OUTPUT_PINS inOutputPin, uint16_t inOn_ms, uint16_t inOff_ms, uint16_t inCount);
+int8_t otd_DigitalPulse(enum DIGITAL_OUTPUT_PINS inOutputPin, uint16_t inOn_ms);
+uint8_t otd_DigitalGetTimedMask();
 void otd_OutputEnable();
 void otd_OutputDisable();
 
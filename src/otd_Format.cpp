@@ -0,0 +1,354 @@
+/**
+  ******************************************************************************
+  * @file    otd_Format.cpp
+  * @author  OtomaDUINO Team
+  * @brief   This file contains number formatting and printf functions.
+  ******************************************************************************
+  * @attention
+  *
+  * Copyright (c) 2022 ML-VPN.
+  * All rights reserved.
+  *
+  * This software is licensed under terms that can be found in the LICENSE file
+  * in the root directory of this software component.
+  * If no LICENSE file comes with this software, it is provided AS-IS.
+  *
+  ******************************************************************************
+  */
+
+#include "otd_Format.h"
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+#include <avr/pgmspace.h>
+
+#include "otd_CorePeri.h"
+
+
+/*
+ * ::: NOTE :::	AVR has no divide instruction, a 32 bit divide by 10 costs hundreds of cycles per digit.
+ * 				Subtracting powers of 10 needs at most 9 subtractions per digit and only adds.
+ */
+static const uint32_t sPow10[] PROGMEM = {
+	1000000000UL,
+	100000000UL,
+	10000000UL,
+	1000000UL,
+	100000UL,
+	10000UL,
+	1000UL,
+	100UL,
+	10UL
+};
+#define POW10_COUNT		(sizeof(sPow10) / sizeof(uint32_t))
+
+static const char sHexDigit[] PROGMEM = "0123456789ABCDEF";
+
+
+static uint8_t put_digits(char *outStr, uint32_t inValue);
+
+
+
+uint8_t otd_FormatUint(char *outStr, uint32_t inValue){
+
+	uint8_t tmpLength = put_digits(outStr, inValue);
+	outStr[tmpLength] = 0;
+
+	return tmpLength;
+}
+
+
+
+uint8_t otd_FormatInt(char *outStr, int32_t inValue){
+
+	if (inValue < 0){
+		outStr[0] = '-';
+		// Negate as unsigned, so INT32_MIN works too
+		return otd_FormatUint(outStr + 1, 0UL - (uint32_t)inValue) + 1;
+	}
+
+	return otd_FormatUint(outStr, (uint32_t)inValue);
+}
+
+
+
+uint8_t otd_FormatFixed(char *outStr, int32_t inValue, uint8_t inDecimals){
+
+	char tmpDigits[11];
+	uint8_t outLength = 0;
+
+	if (inDecimals > 9){
+		inDecimals = 9;
+	}
+
+	uint32_t tmpValue = (uint32_t)inValue;
+	if (inValue < 0){
+		outStr[outLength++] = '-';
+		tmpValue = 0UL - tmpValue;
+	}
+
+	// Take all digits first, then place the point. So the whole part needs no divide
+	uint8_t digitCount = put_digits(tmpDigits, tmpValue);
+	if (digitCount <= inDecimals){
+		// Only the fraction, e.g. "0.0012"
+		outStr[outLength++] = '0';
+		outStr[outLength++] = '.';
+		for (uint8_t i = digitCount; i < inDecimals; i++){
+			outStr[outLength++] = '0';
+		}
+		for (uint8_t i = 0; i < digitCount; i++){
+			outStr[outLength++] = tmpDigits[i];
+		}
+	}else{
+		uint8_t wholeCount = digitCount - inDecimals;
+		for (uint8_t i = 0; i < digitCount; i++){
+			if (i == wholeCount){
+				outStr[outLength++] = '.';
+			}
+			outStr[outLength++] = tmpDigits[i];
+		}
+	}
+	outStr[outLength] = 0;
+
+	return outLength;
+}
+
+
+
+// Prints "inDigits" digits, zero padded. Zero gives the shortest form
+uint8_t otd_FormatHex(char *outStr, uint32_t inValue, uint8_t inDigits){
+
+	if (inDigits == 0 || inDigits > 8){
+		inDigits = 1;
+		for (uint32_t tmpValue = inValue >> 4; tmpValue != 0; tmpValue >>= 4){
+			inDigits = inDigits + 1;
+		}
+	}
+
+	for (uint8_t i = 0; i < inDigits; i++){
+		outStr[inDigits - 1 - i] = pgm_read_byte(&sHexDigit[inValue & 0x0F]);
+		inValue >>= 4;
+	}
+	outStr[inDigits] = 0;
+
+	return inDigits;
+}
+
+
+
+// Prints "inBits" bits, MSB first. Zero gives the shortest form
+uint8_t otd_FormatBin(char *outStr, uint32_t inValue, uint8_t inBits){
+
+	if (inBits == 0 || inBits > 32){
+		inBits = 1;
+		for (uint32_t tmpValue = inValue >> 1; tmpValue != 0; tmpValue >>= 1){
+			inBits = inBits + 1;
+		}
+	}
+
+	for (uint8_t i = 0; i < inBits; i++){
+		outStr[inBits - 1 - i] = (inValue & 1) ? '1' : '0';
+		inValue >>= 1;
+	}
+	outStr[inBits] = 0;
+
+	return inBits;
+}
+
+
+
+uint8_t otd_Vsnprintf(char *outStr, uint8_t inSize, const char *inFormat, va_list inArgs){
+
+	char tmpField[OTD_FORMAT_FIELD_MAX + 1];
+	uint8_t outLength = 0;
+
+	if (inSize == 0){
+		return 0;
+	}
+	// Keep room for the terminator
+	inSize = inSize - 1;
+
+	while (*inFormat != 0 && outLength < inSize){
+		char c = *inFormat++;
+		if (c != '%'){
+			outStr[outLength++] = c;
+			continue;
+		}
+
+		// Flags, width, precision and length
+		uint8_t isLeft = 0;
+		char padChar = ' ';
+		uint8_t tmpWidth = 0;
+		uint8_t tmpPrecision = 0;
+		uint8_t isLong = 0;
+		while (*inFormat == '-' || *inFormat == '0'){
+			if (*inFormat == '-'){
+				isLeft = 1;
+			}else{
+				padChar = '0';
+			}
+			inFormat++;
+		}
+		while (*inFormat >= '0' && *inFormat <= '9'){
+			tmpWidth = tmpWidth * 10 + (*inFormat++ - '0');
+		}
+		if (*inFormat == '.'){
+			inFormat++;
+			while (*inFormat >= '0' && *inFormat <= '9'){
+				tmpPrecision = tmpPrecision * 10 + (*inFormat++ - '0');
+			}
+		}
+		if (*inFormat == 'l'){
+			isLong = 1;
+			inFormat++;
+		}
+
+		// Conversion into the field buffer
+		const char *fieldStr = tmpField;
+		uint8_t fieldLength;
+		c = *inFormat;
+		if (c == 0){
+			break;
+		}
+		inFormat++;
+		switch (c){
+		case 'd':
+		case 'i':
+			fieldLength = otd_FormatInt(tmpField, isLong ? va_arg(inArgs, int32_t) : va_arg(inArgs, int));
+			break;
+
+		case 'u':
+			fieldLength = otd_FormatUint(tmpField, isLong ? va_arg(inArgs, uint32_t) : va_arg(inArgs, unsigned int));
+			break;
+
+		case 'x':
+		case 'X':
+			fieldLength = otd_FormatHex(tmpField, isLong ? va_arg(inArgs, uint32_t) : va_arg(inArgs, unsigned int), 0);
+			if (c == 'x'){
+				for (uint8_t i = 0; i < fieldLength; i++){
+					if (tmpField[i] >= 'A'){
+						tmpField[i] = tmpField[i] + ('a' - 'A');
+					}
+				}
+			}
+			break;
+
+		case 'b':
+			fieldLength = otd_FormatBin(tmpField, isLong ? va_arg(inArgs, uint32_t) : va_arg(inArgs, unsigned int), 0);
+			break;
+
+		case 'q':
+			// Fixed point is always a long, precision is the number of decimals
+			fieldLength = otd_FormatFixed(tmpField, va_arg(inArgs, int32_t), tmpPrecision);
+			break;
+
+		case 'c':
+			tmpField[0] = (char)va_arg(inArgs, int);
+			fieldLength = 1;
+			break;
+
+		case 's':
+			fieldStr = va_arg(inArgs, const char *);
+			if (fieldStr == 0){
+				fieldStr = "(null)";
+			}
+			fieldLength = 0;
+			while (fieldStr[fieldLength] != 0 && fieldLength < 0xFF){
+				fieldLength = fieldLength + 1;
+			}
+			break;
+
+		default:
+			// "%%" and unknown conversions print the character itself
+			tmpField[0] = c;
+			fieldLength = 1;
+			break;
+		}
+
+		// Zero padding goes after the sign
+		if (padChar == '0' && isLeft == 0 && fieldStr == tmpField && tmpField[0] == '-' && fieldLength < tmpWidth){
+			outStr[outLength++] = '-';
+			fieldStr++;
+			fieldLength--;
+			tmpWidth--;
+		}
+		uint8_t padCount = (fieldLength < tmpWidth) ? tmpWidth - fieldLength : 0;
+		if (isLeft == 0){
+			for (; padCount > 0 && outLength < inSize; padCount--){
+				outStr[outLength++] = padChar;
+			}
+		}
+		for (uint8_t i = 0; i < fieldLength && outLength < inSize; i++){
+			outStr[outLength++] = fieldStr[i];
+		}
+		for (; padCount > 0 && outLength < inSize; padCount--){
+			outStr[outLength++] = ' ';
+		}
+	}
+	outStr[outLength] = 0;
+
+	return outLength;
+}
+
+
+
+uint8_t otd_Snprintf(char *outStr, uint8_t inSize, const char *inFormat, ...){
+
+	va_list tmpArgs;
+
+	va_start(tmpArgs, inFormat);
+	uint8_t tmpLength = otd_Vsnprintf(outStr, inSize, inFormat, tmpArgs);
+	va_end(tmpArgs);
+
+	return tmpLength;
+}
+
+
+
+// Whole line is formatted first, then queued to the UART at once
+uint8_t otd_UartPrintf(const char *inFormat, ...){
+
+	char tmpLine[OTD_PRINTF_BUF_SIZE];
+	va_list tmpArgs;
+
+	va_start(tmpArgs, inFormat);
+	uint8_t tmpLength = otd_Vsnprintf(tmpLine, sizeof(tmpLine), inFormat, tmpArgs);
+	va_end(tmpArgs);
+
+	for (uint8_t i = 0; i < tmpLength; i++){
+		otd_UartPrintByte(tmpLine[i]);
+	}
+
+	return tmpLength;
+}
+
+
+
+// Writes the decimal digits without leading zeros and without a terminator
+static uint8_t put_digits(char *outStr, uint32_t inValue){
+
+	uint8_t outLength = 0;
+
+	for (uint8_t i = 0; i < POW10_COUNT; i++){
+		uint32_t tmpPow = pgm_read_dword(&sPow10[i]);
+		char tmpDigit = '0';
+		while (inValue >= tmpPow){
+			inValue -= tmpPow;
+			tmpDigit = tmpDigit + 1;
+		}
+		if (tmpDigit != '0' || outLength != 0){
+			outStr[outLength++] = tmpDigit;
+		}
+	}
+	outStr[outLength++] = '0' + (uint8_t)inValue;
+
+	return outLength;
+}
+
+
+
+#ifdef __cplusplus
+}
+#endif
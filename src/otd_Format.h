@@ -0,0 +1,64 @@
+/**
+  ******************************************************************************
+  * @file    otd_Format.h
+  * @author  OtomaDUINO Team
+  * @brief   This file contains number formatting and printf prototypes.
+  ******************************************************************************
+  * @attention
+  *
+  * Copyright (c) 2022 ML-VPN.
+  * All rights reserved.
+  *
+  * This software is licensed under terms that can be found in the LICENSE file
+  * in the root directory of this software component.
+  * If no LICENSE file comes with this software, it is provided AS-IS.
+  *
+  ******************************************************************************
+  */
+
+#ifndef OTD_FORMAT_H_
+#define OTD_FORMAT_H_
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+#include <stdint.h>
+#include <stdarg.h>
+
+
+// otd_UartPrintf() builds the line on the stack, longer lines are cut
+#ifndef OTD_PRINTF_BUF_SIZE
+#define OTD_PRINTF_BUF_SIZE		64
+#endif
+// Longest field: 32 bit binary or a signed fixed point value with "0." in front
+#define OTD_FORMAT_FIELD_MAX	34
+
+
+/*
+ * ::: NOTE :::	Format functions write a NUL terminated string and return its length. "outStr" needs
+ * 				OTD_FORMAT_FIELD_MAX bytes at most. No division and no float is used: decimal digits are
+ * 				taken by subtracting powers of 10.
+ * 				Fixed point values are integers scaled by 10^decimals, e.g. otd_FormatFixed(s, 1234567, 6)
+ * 				gives "1.234567" for 1234567uV.
+ */
+uint8_t otd_FormatUint(char *outStr, uint32_t inValue);
+uint8_t otd_FormatInt(char *outStr, int32_t inValue);
+uint8_t otd_FormatFixed(char *outStr, int32_t inValue, uint8_t inDecimals);
+uint8_t otd_FormatHex(char *outStr, uint32_t inValue, uint8_t inDigits);
+uint8_t otd_FormatBin(char *outStr, uint32_t inValue, uint8_t inBits);
+/*
+ * ::: NOTE :::	Supported conversions: %d %i %u %x %X %b %c %s %q and %%, with "l" for 32 bit values.
+ * 				Flags "-" and "0", width and precision are supported. "%.Nq" prints a long which is
+ * 				scaled by 10^N as a fixed point number. No float conversions.
+ */
+uint8_t otd_Vsnprintf(char *outStr, uint8_t inSize, const char *inFormat, va_list inArgs);
+uint8_t otd_Snprintf(char *outStr, uint8_t inSize, const char *inFormat, ...);
+uint8_t otd_UartPrintf(const char *inFormat, ...);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* OTD_FORMAT_H_ */
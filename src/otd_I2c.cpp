@@ -0,0 +1,721 @@
+/**
+  ******************************************************************************
+  * @file    otd_I2c.cpp
+  * @author  OtomaDUINO Team
+  * @brief   This file contains software I2C master functions.
+  ******************************************************************************
+  * @attention
+  *
+  * Copyright (c) 2022 ML-VPN.
+  * All rights reserved.
+  *
+  * This software is licensed under terms that can be found in the LICENSE file
+  * in the root directory of this software component.
+  * If no LICENSE file comes with this software, it is provided AS-IS.
+  *
+  ******************************************************************************
+  */
+
+#include "otd_I2c.h"
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <string.h>
+#include <avr/pgmspace.h>
+#include <util/delay_basic.h>
+
+#include "otd_Timebase.h"
+#include "otd_Profile.h"
+#include "otd_Memory.h"
+
+
+/*
+ * I2C DEFINITIONS
+ */
+/* The connection of the 2-wire interface is related to the actual circuit */
+#define I2C_SCL_PORT_DIR		DDRE
+#define I2C_SCL_PORT_OUT		PORTE
+#define I2C_SCL_PIN				3
+//
+#define I2C_SDA_PORT_DIR		DDRD
+#define I2C_SDA_PORT_OUT		PORTD
+#define I2C_SDA_PORT_IN			PIND
+#define I2C_SDA_PIN				7
+/* The bit operation of the 2-wire interface is related to the microcontroller */
+#define I2C_SCL_SET				(I2C_SCL_PORT_OUT |= (1 << I2C_SCL_PIN))
+#define I2C_SCL_CLR				(I2C_SCL_PORT_OUT &= ~(1 << I2C_SCL_PIN))
+#define I2C_SCL_D_OUT			(I2C_SCL_PORT_DIR |= (1 << I2C_SCL_PIN))
+//
+#define I2C_SDA_SET				(I2C_SDA_PORT_OUT |= (1 << I2C_SDA_PIN))
+#define I2C_SDA_CLR				(I2C_SDA_PORT_OUT &= ~(1 << I2C_SDA_PIN))
+#define I2C_SDA_IN				(I2C_SDA_PORT_IN & (1 << I2C_SDA_PIN))
+#define I2C_SDA_D_OUT			(I2C_SDA_PORT_DIR |= (1 << I2C_SDA_PIN))
+// ::: NOTE :::	Setting SDA while it is input, sets the internal pull up resistor
+#define I2C_SDA_D_IN			{(I2C_SDA_PORT_DIR &= ~(1 << I2C_SDA_PIN));(I2C_SDA_SET);}
+/*
+ * ::: NOTE :::	Each half period is the pin write and the loading of the loop count, about 6 cycles, plus
+ * 				3 cycles for each loop. Low and high times meet the minimums of the I2C standard and add up
+ * 				to the clock period, so the rate is not exceeded before rise and fall times are counted.
+ */
+#define I2C_HALF_OVERHEAD_CYCLES	6
+#define I2C_NS_TO_CYCLES(ns)		(((uint32_t)(ns) * (F_CPU / 1000000UL) + 999) / 1000)
+#define I2C_DELAY_LOOPS(ns)			((I2C_NS_TO_CYCLES(ns) > I2C_HALF_OVERHEAD_CYCLES) ? \
+										(I2C_NS_TO_CYCLES(ns) - I2C_HALF_OVERHEAD_CYCLES + 2) / 3 : 0)
+#define I2C_TIMING(lowNs, highNs)	{ I2C_DELAY_LOOPS(lowNs), I2C_DELAY_LOOPS(highNs) }
+static_assert(I2C_DELAY_LOOPS(10000) < 256, "I2C delay loop count must fit in 8 bits");
+// SDA is pulled up by the internal resistor when it is released, give it time to rise
+#define I2C_RELEASE_LOOPS			I2C_DELAY_LOOPS(5000)
+// Standard bus recovery: a device in the middle of a byte needs 9 clocks at most to release SDA
+#define I2C_RECOVER_CLOCKS			9
+
+struct i2c_timing {
+	uint8_t lowLoops;
+	uint8_t highLoops;
+};
+// Same order as OTD_I2C_SPEED
+static const struct i2c_timing sTimingTable[OTD_I2C_SPEED_COUNT] PROGMEM = {
+	I2C_TIMING(5300, 4700),
+	I2C_TIMING(1300, 1200),
+	I2C_TIMING(500, 500),
+	I2C_TIMING(10000, 5000)
+};
+
+static uint8_t sSpeed = OTD_I2C_SPEED_DEFAULT;
+static uint8_t sLowLoops = 0;
+static uint8_t sHighLoops = 0;
+// Bus state is not known after reset or after a failed transaction
+static uint8_t sNeedsRecovery = 1;
+static struct OTD_I2C_STATS sStats;
+
+static_assert((OTD_I2C_QUEUE_SIZE & (OTD_I2C_QUEUE_SIZE - 1)) == 0, "OTD_I2C_QUEUE_SIZE must be a power of 2");
+/*
+ * ::: NOTE :::	Background engine states. Each tick runs one step. SDA is set up at the end of a step,
+ * 				so it has a whole tick to settle before SCL rises.
+ */
+#define ASYNC_IDLE					0
+#define ASYNC_START					1
+#define ASYNC_BIT					2
+#define ASYNC_STOP					3
+#define ASYNC_RECOVER				4
+static struct OTD_I2C_XFER *sQueue[OTD_I2C_QUEUE_SIZE];
+static volatile uint8_t sQueueHead = 0;
+static volatile uint8_t sQueueTail = 0;
+static volatile uint8_t sAsyncState = ASYNC_IDLE;
+static volatile uint8_t sIsBlocking = 0;
+static struct OTD_I2C_XFER *sXfer = 0;
+static uint8_t sByteIndex = 0;				// 0 is the address byte
+static uint8_t sBitIndex = 0;				// 8 is the acknowledge bit
+static uint8_t sShift = 0;
+static uint8_t sIsStopFinal = 0;
+static int8_t sResult = OTD_I2C_OK;
+static uint8_t sRetryCount = 0;
+static uint8_t sRecoverClocks = 0;
+static uint8_t sIsHooked = 0;
+// Reported by otd_Memory
+const uint16_t otd_RamUsage_I2c = sizeof(sQueue) + sizeof(sQueueHead) + sizeof(sQueueTail) + sizeof(sAsyncState) +
+									sizeof(sIsBlocking) + sizeof(sXfer) + sizeof(sByteIndex) + sizeof(sBitIndex) +
+									sizeof(sShift) + sizeof(sIsStopFinal) + sizeof(sResult) + sizeof(sRetryCount) +
+									sizeof(sRecoverClocks);
+
+
+static inline void i2c_wait(uint8_t inLoops);
+static int8_t i2c_transfer(uint8_t inAddr, uint8_t inIsRead, uint8_t *ioData, uint8_t inLength);
+static int8_t i2c_transfer_retry(uint8_t inAddr, uint8_t inIsRead, uint8_t *ioData, uint8_t inLength);
+static int8_t i2c_recover();
+static void count_error(int8_t inStatus);
+static void i2c_start();
+static void i2c_stop();
+static uint8_t i2c_write_byte(uint8_t inByte);
+static uint8_t i2c_read_byte(uint8_t inIsLast);
+static void bus_acquire();
+static void bus_release();
+static void async_step();
+static void async_setup_bit();
+static void async_end();
+static void async_finish(int8_t inStatus);
+
+
+
+void otd_InitI2c(){
+
+	I2C_SCL_SET;		// Set SCL high
+	I2C_SCL_D_OUT;		// Set SCL as output
+	I2C_SDA_SET;		// Set SDA high
+	I2C_SDA_D_OUT;		// Set SDA as output
+
+	otd_I2cSetSpeed((enum OTD_I2C_SPEED)sSpeed);
+	sNeedsRecovery = 1;
+
+	if (sIsHooked == 0){
+		if (otd_AddTickHook(async_step) == 0){
+			sIsHooked = 1;
+		}
+	}
+
+	return;
+}
+
+
+
+int8_t otd_I2cSetSpeed(enum OTD_I2C_SPEED inSpeed){
+
+	if (inSpeed >= OTD_I2C_SPEED_COUNT){
+		return -1;
+	}
+
+	sSpeed = inSpeed;
+	sLowLoops = pgm_read_byte(&sTimingTable[inSpeed].lowLoops);
+	sHighLoops = pgm_read_byte(&sTimingTable[inSpeed].highLoops);
+
+	return 0;
+}
+
+
+enum OTD_I2C_SPEED otd_I2cGetSpeed(){
+	return (enum OTD_I2C_SPEED)sSpeed;
+}
+
+
+
+int8_t otd_I2cRead(uint8_t inAddr, uint8_t *outData, uint8_t inLength){
+
+	bus_acquire();
+	int8_t tmpStatus = i2c_transfer_retry(inAddr, 1, outData, inLength);
+	bus_release();
+
+	return tmpStatus;
+}
+
+
+
+int8_t otd_I2cWrite(uint8_t inAddr, const uint8_t *inData, uint8_t inLength){
+
+	bus_acquire();
+	// Written data is only read
+	int8_t tmpStatus = i2c_transfer_retry(inAddr, 0, (uint8_t *)inData, inLength);
+	bus_release();
+
+	return tmpStatus;
+}
+
+
+
+int8_t otd_I2cTransfer(struct OTD_I2C_XFER *ioXfers, uint8_t inCount){
+
+	int8_t retVal = OTD_I2C_OK;
+
+	bus_acquire();
+	for (uint8_t i = 0; i < inCount; i++){
+		struct OTD_I2C_XFER *curXfer = &ioXfers[i];
+		curXfer->status = i2c_transfer_retry(curXfer->addr, curXfer->isRead, curXfer->data, curXfer->length);
+		if (retVal == OTD_I2C_OK){
+			retVal = curXfer->status;
+		}
+	}
+	bus_release();
+
+	return retVal;
+}
+
+
+
+// Brings the bus to idle from any state
+int8_t otd_I2cRecover(){
+
+	bus_acquire();
+	int8_t tmpStatus = i2c_recover();
+	if (tmpStatus != OTD_I2C_OK){
+		count_error(tmpStatus);
+	}
+	bus_release();
+
+	return tmpStatus;
+}
+
+
+
+void otd_I2cGetStats(struct OTD_I2C_STATS *outStats){
+
+	uint8_t oldSREG = SREG;
+	cli();
+	*outStats = sStats;
+	SREG = oldSREG;
+
+	return;
+}
+
+
+void otd_I2cResetStats(){
+
+	uint8_t oldSREG = SREG;
+	cli();
+	memset(&sStats, 0, sizeof(struct OTD_I2C_STATS));
+	SREG = oldSREG;
+
+	return;
+}
+
+
+
+// Queues a transaction for the background engine. Returns -1 if the queue is full or it is already queued
+int8_t otd_I2cSubmit(struct OTD_I2C_XFER *inXfer){
+
+	int8_t retVal = -1;
+
+	uint8_t oldSREG = SREG;
+	cli();
+	OTD_PROFILE_CLI_BEGIN();
+	uint8_t nextHead = (sQueueHead + 1) & (OTD_I2C_QUEUE_SIZE - 1);
+	if (nextHead != sQueueTail && inXfer->status != OTD_I2C_PENDING){
+		inXfer->status = OTD_I2C_PENDING;
+		sQueue[sQueueHead] = inXfer;
+		sQueueHead = nextHead;
+		retVal = 0;
+	}
+	OTD_PROFILE_CLI_END();
+	SREG = oldSREG;
+
+	return retVal;
+}
+
+
+uint8_t otd_I2cIsBusy(){
+	return (sAsyncState != ASYNC_IDLE || sQueueHead != sQueueTail);
+}
+
+
+
+// The bus is already taken
+static int8_t i2c_transfer_retry(uint8_t inAddr, uint8_t inIsRead, uint8_t *ioData, uint8_t inLength){
+
+	int8_t tmpStatus = i2c_transfer(inAddr, inIsRead, ioData, inLength);
+	for (uint8_t i = 0; i < OTD_I2C_RETRY_MAX && tmpStatus != OTD_I2C_OK; i++){
+		count_error(tmpStatus);
+		sStats.retryCount = sStats.retryCount + 1;
+		tmpStatus = i2c_transfer(inAddr, inIsRead, ioData, inLength);
+	}
+	if (tmpStatus != OTD_I2C_OK){
+		count_error(tmpStatus);
+		sStats.failCount = sStats.failCount + 1;
+	}
+
+	return tmpStatus;
+}
+
+
+// One try, the bus is already taken
+static int8_t i2c_transfer(uint8_t inAddr, uint8_t inIsRead, uint8_t *ioData, uint8_t inLength){
+
+	if (sNeedsRecovery){
+		if (i2c_recover() != OTD_I2C_OK){
+			return OTD_I2C_BUS_STUCK;
+		}
+	}
+
+	if (sSpeed == OTD_I2C_SPEED_BASELINE){
+		// Old code sent a STOP before every START
+		I2C_SCL_CLR;
+		i2c_wait(sLowLoops);
+		i2c_stop();
+	}
+	i2c_start();
+	if (i2c_write_byte((inAddr << 1) | (inIsRead ? 1 : 0)) == 0){
+		i2c_stop();
+		sNeedsRecovery = 1;
+		return OTD_I2C_NACK_ADDR;
+	}
+	for (uint8_t i = 0; i < inLength; i++){
+		if (inIsRead){
+			// Last byte is not acknowledged, so the device releases SDA for the stop
+			ioData[i] = i2c_read_byte(i == inLength - 1);
+		}else if (i2c_write_byte(ioData[i]) == 0){
+			i2c_stop();
+			sNeedsRecovery = 1;
+			return OTD_I2C_NACK_DATA;
+		}
+	}
+	i2c_stop();
+
+	return OTD_I2C_OK;
+}
+
+
+static void count_error(int8_t inStatus){
+
+	switch (inStatus){
+	case OTD_I2C_NACK_ADDR:
+		sStats.nackAddrCount = sStats.nackAddrCount + 1;
+		break;
+
+	case OTD_I2C_NACK_DATA:
+		sStats.nackDataCount = sStats.nackDataCount + 1;
+		break;
+
+	case OTD_I2C_BUS_STUCK:
+		sStats.busStuckCount = sStats.busStuckCount + 1;
+		break;
+
+	default:
+		break;
+	}
+
+	return;
+}
+
+
+// Waits for the background engine to finish the queue, then keeps it away
+static void bus_acquire(){
+
+	while (1){
+		uint8_t oldSREG = SREG;
+		cli();
+		OTD_PROFILE_CLI_BEGIN();
+		if (sAsyncState == ASYNC_IDLE && sQueueHead == sQueueTail){
+			sIsBlocking = 1;
+			OTD_PROFILE_CLI_END();
+			SREG = oldSREG;
+			break;
+		}
+		OTD_PROFILE_CLI_END();
+		SREG = oldSREG;
+	}
+
+	return;
+}
+
+
+static void bus_release(){
+	sIsBlocking = 0;
+	return;
+}
+
+
+
+// Called from the tick interrupt
+static void async_step(){
+
+	uint8_t tmpBit;
+
+	switch (sAsyncState){
+	case ASYNC_IDLE:
+		if (sIsBlocking || sQueueHead == sQueueTail){
+			return;
+		}
+		sXfer = sQueue[sQueueTail];
+		if (sNeedsRecovery){
+			// Release SDA with SCL high, it is checked on the next step
+			sStats.recoveryCount = sStats.recoveryCount + 1;
+			I2C_SDA_D_IN;
+			I2C_SCL_SET;
+			sRecoverClocks = 0;
+			sAsyncState = ASYNC_RECOVER;
+			return;
+		}
+		// fall through
+
+	case ASYNC_START:
+		i2c_start();
+		sByteIndex = 0;
+		sBitIndex = 0;
+		sShift = (sXfer->addr << 1) | (sXfer->isRead ? 1 : 0);
+		async_setup_bit();
+		sAsyncState = ASYNC_BIT;
+		return;
+
+	case ASYNC_BIT:
+		I2C_SCL_SET;
+		i2c_wait(sHighLoops);
+		tmpBit = (I2C_SDA_IN != 0);
+		I2C_SCL_CLR;
+
+		if (sByteIndex != 0 && sXfer->isRead){
+			// Data byte from the device
+			if (sBitIndex < 8){
+				sShift = (sShift << 1) | tmpBit;
+			}else{
+				sXfer->data[sByteIndex - 1] = sShift;
+			}
+		}else if (sBitIndex == 8 && tmpBit != 0){
+			// Not acknowledged, stop here
+			sNeedsRecovery = 1;
+			I2C_SDA_D_OUT;
+			I2C_SDA_CLR;
+			sIsStopFinal = 1;
+			sResult = (sByteIndex == 0) ? OTD_I2C_NACK_ADDR : OTD_I2C_NACK_DATA;
+			sAsyncState = ASYNC_STOP;
+			return;
+		}
+
+		sBitIndex = sBitIndex + 1;
+		if (sBitIndex == 9){
+			sBitIndex = 0;
+			sByteIndex = sByteIndex + 1;
+			if (sByteIndex > sXfer->length){
+				I2C_SDA_D_OUT;
+				I2C_SDA_CLR;
+				sIsStopFinal = 1;
+				sResult = OTD_I2C_OK;
+				sAsyncState = ASYNC_STOP;
+				return;
+			}
+			sShift = sXfer->isRead ? 0 : sXfer->data[sByteIndex - 1];
+		}
+		async_setup_bit();
+		return;
+
+	case ASYNC_STOP:
+		I2C_SCL_SET;
+		i2c_wait(sHighLoops);
+		I2C_SDA_SET;
+		// Bus free time passes until the next step
+		if (sIsStopFinal == 0){
+			sAsyncState = ASYNC_START;
+		}else{
+			async_end();
+		}
+		return;
+
+	case ASYNC_RECOVER:
+		if (I2C_SDA_IN != 0){
+			// Released. Stop mark: SDA goes low now, rises while SCL is high on the next step
+			I2C_SCL_CLR;
+			I2C_SDA_CLR;
+			I2C_SDA_D_OUT;
+			sNeedsRecovery = 0;
+			sIsStopFinal = 0;
+			sAsyncState = ASYNC_STOP;
+			return;
+		}
+		if (sRecoverClocks == I2C_RECOVER_CLOCKS){
+			sResult = OTD_I2C_BUS_STUCK;
+			async_end();
+			return;
+		}
+		// One clock, SDA is checked again on the next step
+		I2C_SCL_CLR;
+		i2c_wait(sLowLoops);
+		I2C_SCL_SET;
+		sRecoverClocks = sRecoverClocks + 1;
+		return;
+
+	default:
+		sAsyncState = ASYNC_IDLE;
+		return;
+	}
+}
+
+
+// SCL is low. Drives or releases SDA for the next bit
+static void async_setup_bit(){
+
+	if (sByteIndex == 0 || sXfer->isRead == 0){
+		if (sBitIndex < 8){
+			I2C_SDA_D_OUT;
+			if ((sShift << sBitIndex) & 0x80){
+				I2C_SDA_SET;
+			}else{
+				I2C_SDA_CLR;
+			}
+		}else{
+			I2C_SDA_D_IN;
+		}
+	}else{
+		if (sBitIndex < 8){
+			I2C_SDA_D_IN;
+		}else{
+			// Acknowledge, or not for the last byte
+			if (sByteIndex == sXfer->length){
+				I2C_SDA_SET;
+			}else{
+				I2C_SDA_CLR;
+			}
+			I2C_SDA_D_OUT;
+		}
+	}
+
+	return;
+}
+
+
+// Transaction try is over, with "sResult"
+static void async_end(){
+
+	if (sResult != OTD_I2C_OK){
+		count_error(sResult);
+		if (sRetryCount < OTD_I2C_RETRY_MAX){
+			// Same transaction is taken again from the queue, after a recovery
+			sRetryCount = sRetryCount + 1;
+			sStats.retryCount = sStats.retryCount + 1;
+			sNeedsRecovery = 1;
+			sAsyncState = ASYNC_IDLE;
+			return;
+		}
+		sStats.failCount = sStats.failCount + 1;
+	}
+	sRetryCount = 0;
+	async_finish(sResult);
+
+	return;
+}
+
+
+static void async_finish(int8_t inStatus){
+
+	struct OTD_I2C_XFER *curXfer = sXfer;
+
+	sXfer = 0;
+	sQueueTail = (sQueueTail + 1) & (OTD_I2C_QUEUE_SIZE - 1);
+	sAsyncState = ASYNC_IDLE;
+
+	curXfer->status = inStatus;
+	if (curXfer->callback != 0){
+		curXfer->callback(curXfer);
+	}
+
+	return;
+}
+
+
+
+static inline void i2c_wait(uint8_t inLoops){
+
+	// Zero would be 256 loops
+	if (inLoops != 0){
+		_delay_loop_1(inLoops);
+	}
+
+	return;
+}
+
+
+// Clocks SCL until the device releases SDA, then sends a stop mark. Ends with both lines high
+static int8_t i2c_recover(){
+
+	sStats.recoveryCount = sStats.recoveryCount + 1;
+
+	I2C_SDA_D_IN;
+	I2C_SCL_SET;
+	i2c_wait(I2C_RELEASE_LOOPS);
+	for (uint8_t i = 0; i < I2C_RECOVER_CLOCKS && I2C_SDA_IN == 0; i++){
+		I2C_SCL_CLR;
+		i2c_wait(sLowLoops);
+		I2C_SCL_SET;
+		i2c_wait(I2C_RELEASE_LOOPS);
+	}
+	if (I2C_SDA_IN == 0){
+		// Leave SDA released, next transaction tries again
+		return OTD_I2C_BUS_STUCK;
+	}
+
+	I2C_SCL_CLR;
+	I2C_SDA_CLR;
+	I2C_SDA_D_OUT;
+	i2c_wait(sLowLoops);
+	I2C_SCL_SET;
+	i2c_wait(sHighLoops);
+	I2C_SDA_SET;
+	i2c_wait(sLowLoops);
+
+	sNeedsRecovery = 0;
+
+	return OTD_I2C_OK;
+}
+
+
+// Bus is idle, both lines are high. Ends with SCL low
+static void i2c_start(){
+
+	I2C_SDA_D_OUT;
+	I2C_SDA_CLR;
+	i2c_wait(sHighLoops);
+	I2C_SCL_CLR;
+
+	return;
+}
+
+
+// SCL is low. Ends with both lines high and the bus free time
+static void i2c_stop(){
+
+	I2C_SDA_D_OUT;
+	I2C_SDA_CLR;
+	i2c_wait(sLowLoops);
+	I2C_SCL_SET;
+	i2c_wait(sHighLoops);
+	I2C_SDA_SET;
+	i2c_wait(sLowLoops);
+
+	return;
+}
+
+
+// SCL is low. Returns 1 if the device acknowledges
+static uint8_t i2c_write_byte(uint8_t inByte){
+
+	I2C_SDA_D_OUT;
+	for (uint8_t i = 0; i < 8; i++){
+		if (inByte & 0x80){
+			I2C_SDA_SET;
+		}else{
+			I2C_SDA_CLR;
+		}
+		i2c_wait(sLowLoops);
+		I2C_SCL_SET;
+		i2c_wait(sHighLoops);
+		I2C_SCL_CLR;
+		inByte <<= 1;
+	}
+
+	// Release SDA and read the acknowledge bit
+	I2C_SDA_D_IN;
+	i2c_wait(sLowLoops);
+	I2C_SCL_SET;
+	i2c_wait(sHighLoops);
+	uint8_t hasAck = (I2C_SDA_IN == 0);
+	I2C_SCL_CLR;
+
+	return hasAck;
+}
+
+
+// SCL is low. MSB comes first
+static uint8_t i2c_read_byte(uint8_t inIsLast){
+
+	uint8_t tmpByte = 0;
+
+	I2C_SDA_D_IN;
+	for (uint8_t i = 0; i < 8; i++){
+		i2c_wait(sLowLoops);
+		I2C_SCL_SET;
+		i2c_wait(sHighLoops);
+		tmpByte <<= 1;
+		if (I2C_SDA_IN){
+			tmpByte |= 1;
+		}
+		I2C_SCL_CLR;
+	}
+
+	// Acknowledge, or not for the last byte
+	if (inIsLast){
+		I2C_SDA_SET;
+	}else{
+		I2C_SDA_CLR;
+	}
+	I2C_SDA_D_OUT;
+	i2c_wait(sLowLoops);
+	I2C_SCL_SET;
+	i2c_wait(sHighLoops);
+	I2C_SCL_CLR;
+
+	return tmpByte;
+}
+
+
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,124 @@
+/**
+  ******************************************************************************
+  * @file    otd_I2c.h
+  * @author  OtomaDUINO Team
+  * @brief   This file contains software I2C master prototypes and data types.
+  ******************************************************************************
+  * @attention
+  *
+  * Copyright (c) 2022 ML-VPN.
+  * All rights reserved.
+  *
+  * This software is licensed under terms that can be found in the LICENSE file
+  * in the root directory of this software component.
+  * If no LICENSE file comes with this software, it is provided AS-IS.
+  *
+  ******************************************************************************
+  */
+
+#ifndef OTD_I2C_H_
+#define OTD_I2C_H_
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+#include <stdint.h>
+
+
+/*
+ * ::: NOTE :::	SCL and SDA are bit-banged, SCL low and high times follow the selected profile.
+ * 				STANDARD suits any expander (PCF8574 is rated 100kHz). FAST and FAST_PLUS need a part rated
+ * 				for it and external pull ups, the internal pull up is too weak for short rise times.
+ * 				FAST_PLUS runs as fast as the code can, about 500kHz at 8MHz.
+ * 				BASELINE is the timing the library had before the profiles, 5us steps with SCL low for two of
+ * 				them and a STOP before every blocking transaction. It is kept to measure the others against.
+ */
+enum OTD_I2C_SPEED{
+	OTD_I2C_SPEED_STANDARD = 0,		// 100kHz
+	OTD_I2C_SPEED_FAST,				// 400kHz
+	OTD_I2C_SPEED_FAST_PLUS,		// 1MHz or the code limit
+	OTD_I2C_SPEED_BASELINE,			// About 66kHz, for comparison only
+	OTD_I2C_SPEED_COUNT
+};
+
+#ifndef OTD_I2C_SPEED_DEFAULT
+#define OTD_I2C_SPEED_DEFAULT	OTD_I2C_SPEED_STANDARD
+#endif
+// Transactions waiting for the background engine, must be a power of 2
+#ifndef OTD_I2C_QUEUE_SIZE
+#define OTD_I2C_QUEUE_SIZE		4
+#endif
+// Failed transactions are tried this many times more, after a bus recovery
+#ifndef OTD_I2C_RETRY_MAX
+#define OTD_I2C_RETRY_MAX		2
+#endif
+
+
+enum OTD_I2C_STATUS{
+	OTD_I2C_QUEUE_FULL = -4,		// Background queue had no room, nothing was sent
+	OTD_I2C_BUS_STUCK = -3,			// SDA stays low after 9 clocks
+	OTD_I2C_NACK_DATA = -2,			// Device did not acknowledge a written byte
+	OTD_I2C_NACK_ADDR = -1,			// No device answers to the address
+	OTD_I2C_OK = 0,
+	OTD_I2C_PENDING = 1				// Queued or running
+};
+
+
+// Every failed try is counted by its type, retries included
+struct OTD_I2C_STATS {
+	uint16_t nackAddrCount;
+	uint16_t nackDataCount;
+	uint16_t busStuckCount;
+	uint16_t recoveryCount;			// Bus recoveries run
+	uint16_t retryCount;
+	uint16_t failCount;				// Transactions which failed after all retries
+};
+
+
+/*
+ * ::: NOTE :::	Background transaction, owned by the caller until its status is not OTD_I2C_PENDING.
+ * 				Callback runs in the tick interrupt when the transaction completes, it may be 0.
+ */
+struct OTD_I2C_XFER {
+	uint8_t addr;					// 7 bits
+	uint8_t isRead;
+	uint8_t length;
+	uint8_t *data;
+	void (*callback)(struct OTD_I2C_XFER *inXfer);
+	volatile int8_t status;			// OTD_I2C_STATUS
+};
+
+
+void otd_InitI2c();
+int8_t otd_I2cSetSpeed(enum OTD_I2C_SPEED inSpeed);
+enum OTD_I2C_SPEED otd_I2cGetSpeed();
+/*
+ * ::: NOTE :::	Addresses are 7 bits. Functions return OTD_I2C_STATUS. A failed transaction is tried again
+ * 				up to OTD_I2C_RETRY_MAX times. The bus is recovered before each new try: SCL is clocked
+ * 				until the device releases SDA, at most 9 times, then a stop mark is sent.
+ */
+int8_t otd_I2cRead(uint8_t inAddr, uint8_t *outData, uint8_t inLength);
+int8_t otd_I2cWrite(uint8_t inAddr, const uint8_t *inData, uint8_t inLength);
+int8_t otd_I2cRecover();
+void otd_I2cGetStats(struct OTD_I2C_STATS *outStats);
+void otd_I2cResetStats();
+/*
+ * ::: NOTE :::	Runs the transactions back-to-back in one bus session, nothing else gets the bus in between.
+ * 				Status of each is set, callbacks are not called. Returns the first error, or OTD_I2C_OK.
+ */
+int8_t otd_I2cTransfer(struct OTD_I2C_XFER *ioXfers, uint8_t inCount);
+/*
+ * ::: NOTE :::	The background engine clocks one bit on every tick (128us) from the tick interrupt, so the
+ * 				interrupt grows by about one SCL high time. A one byte read takes 20 ticks (2.6ms).
+ * 				Blocking functions above wait until the queue is empty, do not call them with interrupts masked.
+ */
+int8_t otd_I2cSubmit(struct OTD_I2C_XFER *inXfer);
+uint8_t otd_I2cIsBusy();
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* OTD_I2C_H_ */
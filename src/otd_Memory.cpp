@@ -0,0 +1,208 @@
+/**
+  ******************************************************************************
+  * @file    otd_Memory.cpp
+  * @author  OtomaDUINO Team
+  * @brief   This file contains RAM usage instrumentation functions.
+  ******************************************************************************
+  * @attention
+  *
+  * Copyright (c) 2022 ML-VPN.
+  * All rights reserved.
+  *
+  * This software is licensed under terms that can be found in the LICENSE file
+  * in the root directory of this software component.
+  * If no LICENSE file comes with this software, it is provided AS-IS.
+  *
+  ******************************************************************************
+  */
+
+#include "otd_Memory.h"
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+#include <stdlib.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+
+#include "otd_CorePeri.h"
+
+
+#define MEM_PAINT		0xC5
+
+// Linker and malloc symbols
+extern uint8_t __data_start;
+extern uint8_t __bss_end;
+extern uint8_t __heap_start;
+extern char *__brkval;
+
+static uint8_t *sPaintStart = 0;
+static uint8_t *sPaintEnd = 0;
+
+static const char sSubsysName[OTD_MEM_SUBSYS_COUNT][10] PROGMEM = {
+	"UART",
+	"TIMEBASE",
+	"SCHEDULER",
+	"TIMER",
+	"PROFILE",
+	"MODBUS",
+	"DIGITALIO",
+	"I2C",
+	"ANALOG"
+};
+
+
+static uint8_t *heap_end();
+static void print_line(const char *inName, uint16_t inValue);
+
+
+
+void otd_InitMemory(){
+
+	uint8_t oldSREG = SREG;
+	cli();
+
+	// Paint from the end of heap up to the current stack pointer
+	uint8_t *curPtr = heap_end();
+	sPaintStart = curPtr;
+	sPaintEnd = (uint8_t *)SP;
+	while (curPtr < sPaintEnd){
+		*curPtr++ = MEM_PAINT;
+	}
+
+	SREG = oldSREG;
+
+	return;
+}
+
+
+
+// Current gap between heap and stack
+uint16_t otd_MemGetFree(){
+
+	uint8_t *curHeap = heap_end();
+	uint8_t *curStack = (uint8_t *)SP;
+
+	if (curStack <= curHeap){
+		return 0;
+	}
+	return curStack - curHeap;
+}
+
+
+
+// Deepest stack usage in bytes since otd_InitMemory()
+uint16_t otd_MemGetStackHighWater(){
+
+	if (sPaintStart == 0){
+		return 0;
+	}
+
+	return ((uint8_t *)RAMEND + 1 - sPaintStart) - otd_MemGetStackHeadroom();
+}
+
+
+
+// Painted bytes never touched by the stack (or heap) since otd_InitMemory()
+uint16_t otd_MemGetStackHeadroom(){
+
+	if (sPaintStart == 0){
+		return 0;
+	}
+
+	// Stack grows down, so count paint up from the bottom
+	uint8_t *curPtr = sPaintStart;
+	while (curPtr < sPaintEnd && *curPtr == MEM_PAINT){
+		curPtr++;
+	}
+
+	return curPtr - sPaintStart;
+}
+
+
+
+// All statically allocated RAM (.data and .bss) of the application and the library
+uint16_t otd_MemGetStaticRam(){
+	return &__bss_end - &__data_start;
+}
+
+
+
+uint16_t otd_MemGetSubsysRam(enum OTD_MEM_SUBSYS inSubsys){
+
+	switch (inSubsys){
+	case OTD_MEM_UART:
+		return otd_RamUsage_Uart;
+	case OTD_MEM_TIMEBASE:
+		return otd_RamUsage_Timebase;
+	case OTD_MEM_SCHEDULER:
+		return otd_RamUsage_Scheduler;
+	case OTD_MEM_TIMER:
+		return otd_RamUsage_Timer;
+	case OTD_MEM_PROFILE:
+		return otd_RamUsage_Profile;
+	case OTD_MEM_MODBUS:
+		return otd_RamUsage_Modbus;
+	case OTD_MEM_DIGITALIO:
+		return otd_RamUsage_DigitalIO;
+	case OTD_MEM_I2C:
+		return otd_RamUsage_I2c;
+	case OTD_MEM_ANALOG:
+		return otd_RamUsage_Analog;
+	default:
+		break;
+	}
+
+	return 0;
+}
+
+
+
+void otd_MemDump(){
+
+	print_line(PSTR("FREE"), otd_MemGetFree());
+	print_line(PSTR("STACK MAX"), otd_MemGetStackHighWater());
+	print_line(PSTR("HEADROOM"), otd_MemGetStackHeadroom());
+	print_line(PSTR("STATIC"), otd_MemGetStaticRam());
+	for (uint8_t i = 0; i < OTD_MEM_SUBSYS_COUNT; i++){
+		print_line(sSubsysName[i], otd_MemGetSubsysRam((enum OTD_MEM_SUBSYS)i));
+	}
+
+	return;
+}
+
+
+
+static uint8_t *heap_end(){
+
+	// Heap is empty unless malloc was used
+	if (__brkval == 0){
+		return &__heap_start;
+	}
+	return (uint8_t *)__brkval;
+}
+
+
+static void print_line(const char *inName, uint16_t inValue){
+
+	char tmpStr[8];
+	char c;
+
+	// Name is in flash
+	while ((c = pgm_read_byte(inName++)) != 0){
+		otd_UartPrintByte(c);
+	}
+	otd_UartPrint(": ");
+	utoa(inValue, tmpStr, 10);
+	otd_UartPrintln(tmpStr);
+
+	return;
+}
+
+
+
+#ifdef __cplusplus
+}
+#endif
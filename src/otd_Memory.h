@@ -0,0 +1,74 @@
+/**
+  ******************************************************************************
+  * @file    otd_Memory.h
+  * @author  OtomaDUINO Team
+  * @brief   This file contains RAM usage instrumentation prototypes and data types.
+  ******************************************************************************
+  * @attention
+  *
+  * Copyright (c) 2022 ML-VPN.
+  * All rights reserved.
+  *
+  * This software is licensed under terms that can be found in the LICENSE file
+  * in the root directory of this software component.
+  * If no LICENSE file comes with this software, it is provided AS-IS.
+  *
+  ******************************************************************************
+  */
+
+#ifndef OTD_MEMORY_H_
+#define OTD_MEMORY_H_
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+#include <stdint.h>
+
+
+enum OTD_MEM_SUBSYS{
+	OTD_MEM_UART = 0,
+	OTD_MEM_TIMEBASE,
+	OTD_MEM_SCHEDULER,
+	OTD_MEM_TIMER,
+	OTD_MEM_PROFILE,
+	OTD_MEM_MODBUS,
+	OTD_MEM_DIGITALIO,
+	OTD_MEM_I2C,
+	OTD_MEM_ANALOG,
+	OTD_MEM_SUBSYS_COUNT
+};
+
+
+/*
+ * ::: NOTE :::	otd_InitMemory() paints the free RAM between heap and stack. Call it early in setup().
+ * 				Stack high water is the deepest the stack has grown since then, headroom is the paint never touched.
+ */
+void otd_InitMemory();
+uint16_t otd_MemGetFree();
+uint16_t otd_MemGetStackHighWater();
+uint16_t otd_MemGetStackHeadroom();
+uint16_t otd_MemGetStaticRam();
+uint16_t otd_MemGetSubsysRam(enum OTD_MEM_SUBSYS inSubsys);
+void otd_MemDump();
+
+
+/*
+ * ::: NOTE :::	Size of the static buffers of each module. Defined in the module itself.
+ */
+extern const uint16_t otd_RamUsage_Uart;
+extern const uint16_t otd_RamUsage_Timebase;
+extern const uint16_t otd_RamUsage_Scheduler;
+extern const uint16_t otd_RamUsage_Timer;
+extern const uint16_t otd_RamUsage_Profile;
+extern const uint16_t otd_RamUsage_Modbus;
+extern const uint16_t otd_RamUsage_DigitalIO;
+extern const uint16_t otd_RamUsage_I2c;
+extern const uint16_t otd_RamUsage_Analog;
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* OTD_MEMORY_H_ */
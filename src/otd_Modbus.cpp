@@ -0,0 +1,666 @@
+/**
+  ******************************************************************************
+  * @file    otd_Modbus.cpp
+  * @author  OtomaDUINO Team
+  * @brief   This file contains Modbus RTU slave functions.
+  ******************************************************************************
+  * @attention
+  *
+  * Copyright (c) 2022 ML-VPN.
+  * All rights reserved.
+  *
+  * This software is licensed under terms that can be found in the LICENSE file
+  * in the root directory of this software component.
+  * If no LICENSE file comes with this software, it is provided AS-IS.
+  *
+  ******************************************************************************
+  */
+
+#include "otd_Modbus.h"
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+#include <string.h>
+
+#include "otd_CorePeri.h"
+#include "otd_Timebase.h"
+#include "otd_DigitalIO.h"
+#include "otd_Pulse.h"
+#include "otd_Memory.h"
+
+
+/*
+ * MODBUS DEFINITIONS
+ */
+#define MB_FC_READ_COILS			0x01
+#define MB_FC_READ_DISCRETE			0x02
+#define MB_FC_READ_HOLDING			0x03
+#define MB_FC_READ_INPUT			0x04
+#define MB_FC_WRITE_COIL			0x05
+#define MB_FC_WRITE_REGISTER		0x06
+#define MB_FC_WRITE_COILS			0x0F
+#define MB_FC_WRITE_REGISTERS		0x10
+#define MB_FC_SAMPLE_NOW			0x41		// User defined range, no data. Mostly sent as broadcast
+//
+#define MB_ADDR_BROADCAST			0
+#define MB_ADDR_MAX					247
+//
+#define MB_COIL_COUNT				6
+#define MB_COIL_MASK_ALL			((1 << MB_COIL_COUNT) - 1)
+#define MB_DISCRETE_COUNT			8
+#define MB_INPUT_REG_COUNT			12
+#define MB_PULSE_REG_STRIDE			5
+#define MB_HOLDING_REG_COUNT		(2 * MB_PULSE_REG_STRIDE)
+//
+#define MB_LATCH_IDLE				0
+#define MB_LATCH_RUN				1
+#define MB_LATCH_RESTART			2		// Requested again while a read runs, read once more after it
+#define MB_LATCH_DELAY_NONE			0xFFFF
+// Address, function, CRC and the byte count of read responses
+#define MB_READ_OVERHEAD			5
+
+// CRC-16/MODBUS (reflected 0x8005, initial 0xFFFF) for every byte value
+static const uint16_t sCrcTable[256] PROGMEM = {
+	0x0000, 0xC0C1, 0xC181, 0x0140, 0xC301, 0x03C0, 0x0280, 0xC241,
+	0xC601, 0x06C0, 0x0780, 0xC741, 0x0500, 0xC5C1, 0xC481, 0x0440,
+	0xCC01, 0x0CC0, 0x0D80, 0xCD41, 0x0F00, 0xCFC1, 0xCE81, 0x0E40,
+	0x0A00, 0xCAC1, 0xCB81, 0x0B40, 0xC901, 0x09C0, 0x0880, 0xC841,
+	0xD801, 0x18C0, 0x1980, 0xD941, 0x1B00, 0xDBC1, 0xDA81, 0x1A40,
+	0x1E00, 0xDEC1, 0xDF81, 0x1F40, 0xDD01, 0x1DC0, 0x1C80, 0xDC41,
+	0x1400, 0xD4C1, 0xD581, 0x1540, 0xD701, 0x17C0, 0x1680, 0xD641,
+	0xD201, 0x12C0, 0x1380, 0xD341, 0x1100, 0xD1C1, 0xD081, 0x1040,
+	0xF001, 0x30C0, 0x3180, 0xF141, 0x3300, 0xF3C1, 0xF281, 0x3240,
+	0x3600, 0xF6C1, 0xF781, 0x3740, 0xF501, 0x35C0, 0x3480, 0xF441,
+	0x3C00, 0xFCC1, 0xFD81, 0x3D40, 0xFF01, 0x3FC0, 0x3E80, 0xFE41,
+	0xFA01, 0x3AC0, 0x3B80, 0xFB41, 0x3900, 0xF9C1, 0xF881, 0x3840,
+	0x2800, 0xE8C1, 0xE981, 0x2940, 0xEB01, 0x2BC0, 0x2A80, 0xEA41,
+	0xEE01, 0x2EC0, 0x2F80, 0xEF41, 0x2D00, 0xEDC1, 0xEC81, 0x2C40,
+	0xE401, 0x24C0, 0x2580, 0xE541, 0x2700, 0xE7C1, 0xE681, 0x2640,
+	0x2200, 0xE2C1, 0xE381, 0x2340, 0xE101, 0x21C0, 0x2080, 0xE041,
+	0xA001, 0x60C0, 0x6180, 0xA141, 0x6300, 0xA3C1, 0xA281, 0x6240,
+	0x6600, 0xA6C1, 0xA781, 0x6740, 0xA501, 0x65C0, 0x6480, 0xA441,
+	0x6C00, 0xACC1, 0xAD81, 0x6D40, 0xAF01, 0x6FC0, 0x6E80, 0xAE41,
+	0xAA01, 0x6AC0, 0x6B80, 0xAB41, 0x6900, 0xA9C1, 0xA881, 0x6840,
+	0x7800, 0xB8C1, 0xB981, 0x7940, 0xBB01, 0x7BC0, 0x7A80, 0xBA41,
+	0xBE01, 0x7EC0, 0x7F80, 0xBF41, 0x7D00, 0xBDC1, 0xBC81, 0x7C40,
+	0xB401, 0x74C0, 0x7580, 0xB541, 0x7700, 0xB7C1, 0xB681, 0x7640,
+	0x7200, 0xB2C1, 0xB381, 0x7340, 0xB101, 0x71C0, 0x7080, 0xB041,
+	0x5000, 0x90C1, 0x9181, 0x5140, 0x9301, 0x53C0, 0x5280, 0x9241,
+	0x9601, 0x56C0, 0x5780, 0x9741, 0x5500, 0x95C1, 0x9481, 0x5440,
+	0x9C01, 0x5CC0, 0x5D80, 0x9D41, 0x5F00, 0x9FC1, 0x9E81, 0x5E40,
+	0x5A00, 0x9AC1, 0x9B81, 0x5B40, 0x9901, 0x59C0, 0x5880, 0x9841,
+	0x8801, 0x48C0, 0x4980, 0x8941, 0x4B00, 0x8BC1, 0x8A81, 0x4A40,
+	0x4E00, 0x8EC1, 0x8F81, 0x4F40, 0x8D01, 0x4DC0, 0x4C80, 0x8C41,
+	0x4400, 0x84C1, 0x8581, 0x4540, 0x8701, 0x47C0, 0x4680, 0x8641,
+	0x8201, 0x42C0, 0x4380, 0x8341, 0x4100, 0x81C1, 0x8081, 0x4040
+};
+
+static uint8_t sFrame[OTD_MODBUS_BUF_SIZE];
+static uint8_t sFrameLength = 0;
+static uint8_t sIsOverrun = 0;
+static uint8_t sSlaveId = 1;
+static struct OTD_MODBUS_STATS sStats;
+static void (*sSampleHook)(void) = 0;
+static uint8_t sCoilMask = MB_COIL_MASK_ALL;
+//
+static int32_t sAnalogValue = 0;
+static uint8_t sAnalogType = OTD_ANALOG_TYPE_NOT_SET;
+static uint8_t sAnalogChannel = OTD_ANALOG_CHAN_NOT_SET;
+static uint16_t sAnalogSampleCount = 0;
+static uint8_t sLatchedInputs = 0;
+static uint32_t sLatchTime_ms = 0;
+static uint8_t sLatchState = MB_LATCH_IDLE;
+static uint32_t sLatchFrameTick = 0;
+static uint16_t sLatchDelay_us = MB_LATCH_DELAY_NONE;
+// Reported by otd_Memory
+const uint16_t otd_RamUsage_Modbus = sizeof(sFrame);
+
+
+static uint16_t modbus_crc(const uint8_t *inData, uint8_t inLength);
+static uint8_t modbus_execute(uint8_t inPduEnd);
+static uint8_t modbus_exception(uint8_t inCode);
+static uint8_t sample_now(uint8_t inPduEnd);
+static void latch_step();
+static uint8_t read_bits(uint8_t inFunction, uint8_t inPduEnd);
+static uint8_t read_registers(uint8_t inFunction, uint8_t inPduEnd);
+static uint8_t write_coils(uint8_t inFunction, uint8_t inPduEnd);
+static uint8_t write_registers(uint8_t inFunction, uint8_t inPduEnd);
+static uint16_t input_register(uint16_t inAddr);
+static uint16_t holding_register(uint16_t inAddr);
+static uint8_t holding_check(uint16_t inAddr, uint16_t inValue);
+static uint8_t holding_write(uint16_t inAddr, uint16_t inValue);
+static uint16_t get_u16(uint8_t inIndex);
+static void put_u16(uint8_t inIndex, uint16_t inValue);
+
+
+
+int8_t otd_InitModbus(uint8_t inSlaveId){
+
+	if (inSlaveId == MB_ADDR_BROADCAST || inSlaveId > MB_ADDR_MAX){
+		return -1;
+	}
+
+	sSlaveId = inSlaveId;
+	sFrameLength = 0;
+	sIsOverrun = 0;
+	memset(&sStats, 0, sizeof(struct OTD_MODBUS_STATS));
+
+	// Frames for other slaves are dropped by the UART, they never reach the frame buffer
+	otd_UartSetMultiDrop(inSlaveId);
+
+	return 0;
+}
+
+
+
+uint8_t otd_ModbusPoll(){
+
+	if (sLatchState != MB_LATCH_IDLE){
+		latch_step();
+	}
+
+	// Collect the received bytes. A frame which does not fit is dropped as a whole
+	if (sIsOverrun == 0){
+		sFrameLength += otd_UartReadBuffer(&sFrame[sFrameLength], OTD_MODBUS_BUF_SIZE - sFrameLength);
+		if (sFrameLength == OTD_MODBUS_BUF_SIZE && otd_UartAvailable() != 0){
+			sIsOverrun = 1;
+		}
+	}
+	if (sIsOverrun == 1){
+		while (otd_UartRead(0) >= 0);
+	}
+	if (sFrameLength == 0){
+		return 0;
+	}
+
+	// Frame is complete after the silence
+	if ((getUptime_ticks() - otd_UartGetLastRxTick()) < otd_UartGetFrameGapTicks()){
+		return 0;
+	}
+
+	uint8_t tmpLength = sFrameLength;
+	sFrameLength = 0;
+	if (sIsOverrun == 1){
+		sIsOverrun = 0;
+		sStats.overrunCount = sStats.overrunCount + 1;
+		return 0;
+	}
+
+	// Address, function and CRC at least
+	if (tmpLength < 4 || modbus_crc(sFrame, tmpLength - 2) != (sFrame[tmpLength - 2] | ((uint16_t)sFrame[tmpLength - 1] << 8))){
+		sStats.crcErrorCount = sStats.crcErrorCount + 1;
+		return 0;
+	}
+	uint8_t tmpAddr = sFrame[0];
+	if (tmpAddr != sSlaveId && tmpAddr != MB_ADDR_BROADCAST){
+		return 0;
+	}
+	sStats.frameCount = sStats.frameCount + 1;
+
+	// Response is built in the same buffer
+	uint8_t respLength = modbus_execute(tmpLength - 2);
+	if (tmpAddr == MB_ADDR_BROADCAST){
+		// Broadcast is never answered
+		return 1;
+	}
+	uint16_t tmpCrc = modbus_crc(sFrame, respLength);
+	sFrame[respLength] = (uint8_t)tmpCrc;
+	sFrame[respLength + 1] = (uint8_t)(tmpCrc >> 8);
+	for (uint8_t i = 0; i < respLength + 2; i++){
+		otd_UartPrintByte(sFrame[i]);
+	}
+
+	return 1;
+}
+
+
+
+// Give the value of otd_AnalogRead() before the channel or the type is changed
+void otd_ModbusUpdateAnalog(union OTD_ANALOG_VALUE inValue){
+
+	float tmpScaled;
+
+	sAnalogType = otd_GetAnalogType();
+	sAnalogChannel = otd_GetAnalogChannel();
+	if (sAnalogType == OTD_ANALOG_CURRENT){
+		tmpScaled = inValue.current_mA * 1000.0;
+	}else{
+		tmpScaled = inValue.voltage_V * 1000000.0;
+	}
+	sAnalogValue = (int32_t)((tmpScaled < 0) ? tmpScaled - 0.5 : tmpScaled + 0.5);
+	sAnalogSampleCount = sAnalogSampleCount + 1;
+
+	return;
+}
+
+
+
+// Called when "sample now" is received, after the inputs are latched. Keep it short, e.g. start a conversion
+void otd_ModbusSetSampleHook(void (*inHook)(void)){
+	sSampleHook = inHook;
+	return;
+}
+
+
+
+// Outputs with a 0 bit can not be written over Modbus, e.g. a transceiver enable pin
+void otd_ModbusSetCoilMask(uint8_t inMask){
+	sCoilMask = inMask & MB_COIL_MASK_ALL;
+	return;
+}
+
+
+
+void otd_ModbusGetStats(struct OTD_MODBUS_STATS *outStats){
+	*outStats = sStats;
+	return;
+}
+
+
+void otd_ModbusResetStats(){
+	memset(&sStats, 0, sizeof(struct OTD_MODBUS_STATS));
+	return;
+}
+
+
+
+// Runs the request in "sFrame", returns the response length without CRC
+static uint8_t modbus_execute(uint8_t inPduEnd){
+
+	uint8_t tmpFunction = sFrame[1];
+
+	switch (tmpFunction){
+	case MB_FC_READ_COILS:
+	case MB_FC_READ_DISCRETE:
+		return read_bits(tmpFunction, inPduEnd);
+
+	case MB_FC_READ_HOLDING:
+	case MB_FC_READ_INPUT:
+		return read_registers(tmpFunction, inPduEnd);
+
+	case MB_FC_WRITE_COIL:
+	case MB_FC_WRITE_COILS:
+		return write_coils(tmpFunction, inPduEnd);
+
+	case MB_FC_WRITE_REGISTER:
+	case MB_FC_WRITE_REGISTERS:
+		return write_registers(tmpFunction, inPduEnd);
+
+	case MB_FC_SAMPLE_NOW:
+		return sample_now(inPduEnd);
+
+	default:
+		return modbus_exception(OTD_MODBUS_EX_ILLEGAL_FUNCTION);
+	}
+}
+
+
+static uint8_t modbus_exception(uint8_t inCode){
+
+	sStats.exceptionCount = sStats.exceptionCount + 1;
+	sFrame[1] |= 0x80;
+	sFrame[2] = inCode;
+
+	return 3;
+}
+
+
+static uint8_t sample_now(uint8_t inPduEnd){
+
+	if (inPduEnd != 2){
+		return modbus_exception(OTD_MODBUS_EX_ILLEGAL_VALUE);
+	}
+
+	/*
+	 * ::: NOTE :::	Inputs are read now, in the background, and the poll takes the result. The delay is counted
+	 * 				from the end of this frame, which all boards on the line see at the same time.
+	 */
+	sLatchFrameTick = otd_UartGetLastRxTick();
+	sLatchDelay_us = MB_LATCH_DELAY_NONE;
+	if (sLatchState == MB_LATCH_IDLE){
+		sLatchState = MB_LATCH_RUN;
+		latch_step();
+	}else{
+		sLatchState = MB_LATCH_RESTART;
+	}
+	if (sSampleHook != 0){
+		sSampleHook();
+	}
+
+	// Response is the echo of the request
+	return 2;
+}
+
+
+// Takes the result of the "sample now" read. The last good latch is kept if the read fails
+static void latch_step(){
+
+	uint8_t tmpInputs;
+	int8_t tmpStatus = otd_DigitalReadAsync(&tmpInputs);
+
+	if (tmpStatus == OTD_I2C_PENDING){
+		return;
+	}
+	if (sLatchState == MB_LATCH_RESTART){
+		// This read was started before the last request, start another one on the next poll
+		sLatchState = MB_LATCH_RUN;
+		return;
+	}
+	sLatchState = MB_LATCH_IDLE;
+	if (tmpStatus != OTD_I2C_OK){
+		return;
+	}
+
+	uint32_t tmpTicks = getUptime_ticks() - sLatchFrameTick;
+	sLatchedInputs = tmpInputs;
+	sLatchTime_ms = getUptime_ms();
+	if (tmpTicks < MB_LATCH_DELAY_NONE / OTD_TICK_PERIOD_US){
+		sLatchDelay_us = (uint16_t)(tmpTicks * OTD_TICK_PERIOD_US);
+	}else{
+		sLatchDelay_us = MB_LATCH_DELAY_NONE - 1;
+	}
+
+	return;
+}
+
+
+static uint8_t read_bits(uint8_t inFunction, uint8_t inPduEnd){
+
+	if (inPduEnd != 6){
+		return modbus_exception(OTD_MODBUS_EX_ILLEGAL_VALUE);
+	}
+	uint16_t tmpStart = get_u16(2);
+	uint16_t tmpQuantity = get_u16(4);
+	uint16_t tmpCount = (inFunction == MB_FC_READ_COILS) ? MB_COIL_COUNT : MB_DISCRETE_COUNT;
+	if (tmpQuantity == 0 || (tmpQuantity + 7) / 8 > OTD_MODBUS_BUF_SIZE - MB_READ_OVERHEAD){
+		return modbus_exception(OTD_MODBUS_EX_ILLEGAL_VALUE);
+	}
+	if (tmpStart >= tmpCount || tmpQuantity > tmpCount - tmpStart){
+		return modbus_exception(OTD_MODBUS_EX_ILLEGAL_ADDRESS);
+	}
+
+	// Bits are taken once, so all are from the same moment
+	uint8_t tmpBits = (inFunction == MB_FC_READ_DISCRETE) ? otd_DigitalGetSnapshot(0) : otd_DigitalReadOutputs();
+	uint8_t tmpByteCount = (tmpQuantity + 7) / 8;
+	sFrame[2] = tmpByteCount;
+	memset(&sFrame[3], 0, tmpByteCount);
+	for (uint8_t i = 0; i < tmpQuantity; i++){
+		uint8_t tmpAddr = tmpStart + i;
+		if ((tmpBits >> tmpAddr) & 1){
+			sFrame[3 + (i >> 3)] |= (1 << (i & 7));
+		}
+	}
+
+	return 3 + tmpByteCount;
+}
+
+
+static uint8_t read_registers(uint8_t inFunction, uint8_t inPduEnd){
+
+	if (inPduEnd != 6){
+		return modbus_exception(OTD_MODBUS_EX_ILLEGAL_VALUE);
+	}
+	uint16_t tmpStart = get_u16(2);
+	uint16_t tmpQuantity = get_u16(4);
+	uint16_t tmpCount = (inFunction == MB_FC_READ_HOLDING) ? MB_HOLDING_REG_COUNT : MB_INPUT_REG_COUNT;
+	if (tmpQuantity == 0 || tmpQuantity > (OTD_MODBUS_BUF_SIZE - MB_READ_OVERHEAD) / 2){
+		return modbus_exception(OTD_MODBUS_EX_ILLEGAL_VALUE);
+	}
+	if (tmpStart >= tmpCount || tmpQuantity > tmpCount - tmpStart){
+		return modbus_exception(OTD_MODBUS_EX_ILLEGAL_ADDRESS);
+	}
+
+	sFrame[2] = tmpQuantity * 2;
+	for (uint8_t i = 0; i < tmpQuantity; i++){
+		uint16_t tmpValue;
+		if (inFunction == MB_FC_READ_HOLDING){
+			tmpValue = holding_register(tmpStart + i);
+		}else{
+			tmpValue = input_register(tmpStart + i);
+		}
+		put_u16(3 + 2 * i, tmpValue);
+	}
+
+	return 3 + tmpQuantity * 2;
+}
+
+
+static uint8_t write_coils(uint8_t inFunction, uint8_t inPduEnd){
+
+	uint16_t tmpStart = get_u16(2);
+
+	if (inFunction == MB_FC_WRITE_COIL){
+		if (inPduEnd != 6){
+			return modbus_exception(OTD_MODBUS_EX_ILLEGAL_VALUE);
+		}
+		uint16_t tmpValue = get_u16(4);
+		if (tmpValue != 0xFF00 && tmpValue != 0x0000){
+			return modbus_exception(OTD_MODBUS_EX_ILLEGAL_VALUE);
+		}
+		if (tmpStart >= MB_COIL_COUNT || (sCoilMask & (1 << tmpStart)) == 0){
+			return modbus_exception(OTD_MODBUS_EX_ILLEGAL_ADDRESS);
+		}
+		otd_DigitalWrite((enum DIGITAL_OUTPUT_PINS)tmpStart, tmpValue == 0xFF00);
+		// Response is the echo of the request
+		return 6;
+	}
+
+	if (inPduEnd < 7){
+		return modbus_exception(OTD_MODBUS_EX_ILLEGAL_VALUE);
+	}
+	uint16_t tmpQuantity = get_u16(4);
+	uint8_t tmpByteCount = sFrame[6];
+	if (tmpQuantity == 0 || tmpByteCount != (tmpQuantity + 7) / 8 || inPduEnd != 7 + tmpByteCount){
+		return modbus_exception(OTD_MODBUS_EX_ILLEGAL_VALUE);
+	}
+	if (tmpStart >= MB_COIL_COUNT || tmpQuantity > MB_COIL_COUNT - tmpStart){
+		return modbus_exception(OTD_MODBUS_EX_ILLEGAL_ADDRESS);
+	}
+	// All coils change at once
+	uint8_t tmpMask = 0;
+	uint8_t tmpValues = 0;
+	for (uint8_t i = 0; i < tmpQuantity; i++){
+		tmpMask |= (1 << (tmpStart + i));
+		if ((sFrame[7 + (i >> 3)] >> (i & 7)) & 1){
+			tmpValues |= (1 << (tmpStart + i));
+		}
+	}
+	if (tmpMask & ~sCoilMask){
+		return modbus_exception(OTD_MODBUS_EX_ILLEGAL_ADDRESS);
+	}
+	otd_DigitalWriteMask(tmpMask, tmpValues);
+
+	// Response has the start and the quantity
+	return 6;
+}
+
+
+static uint8_t write_registers(uint8_t inFunction, uint8_t inPduEnd){
+
+	uint16_t tmpStart = get_u16(2);
+	uint16_t tmpQuantity = 1;
+	uint8_t tmpDataIndex = 4;
+
+	if (inFunction == MB_FC_WRITE_REGISTER){
+		if (inPduEnd != 6){
+			return modbus_exception(OTD_MODBUS_EX_ILLEGAL_VALUE);
+		}
+	}else{
+		if (inPduEnd < 7){
+			return modbus_exception(OTD_MODBUS_EX_ILLEGAL_VALUE);
+		}
+		tmpQuantity = get_u16(4);
+		if (tmpQuantity == 0 || sFrame[6] != tmpQuantity * 2 || inPduEnd != 7 + tmpQuantity * 2){
+			return modbus_exception(OTD_MODBUS_EX_ILLEGAL_VALUE);
+		}
+		tmpDataIndex = 7;
+	}
+	if (tmpStart >= MB_HOLDING_REG_COUNT || tmpQuantity > MB_HOLDING_REG_COUNT - tmpStart){
+		return modbus_exception(OTD_MODBUS_EX_ILLEGAL_ADDRESS);
+	}
+
+	// Check all values first, so a bad request changes nothing
+	for (uint8_t i = 0; i < tmpQuantity; i++){
+		uint8_t tmpCode = holding_check(tmpStart + i, get_u16(tmpDataIndex + 2 * i));
+		if (tmpCode != OTD_MODBUS_EX_NONE){
+			return modbus_exception(tmpCode);
+		}
+	}
+	for (uint8_t i = 0; i < tmpQuantity; i++){
+		uint8_t tmpCode = holding_write(tmpStart + i, get_u16(tmpDataIndex + 2 * i));
+		if (tmpCode != OTD_MODBUS_EX_NONE){
+			return modbus_exception(tmpCode);
+		}
+	}
+
+	// Single write echoes the request, multiple write returns the start and the quantity
+	return 6;
+}
+
+
+static uint16_t input_register(uint16_t inAddr){
+
+	switch (inAddr){
+	case 0:		return (uint16_t)((uint32_t)sAnalogValue >> 16);
+	case 1:		return (uint16_t)sAnalogValue;
+	case 2:		return sAnalogType;
+	case 3:		return sAnalogChannel;
+	case 4:		return sAnalogSampleCount;
+	case 5:		return otd_DigitalGetSnapshot(0);
+	case 6:		return (uint16_t)(getUptime_ms() >> 16);
+	case 7:		return (uint16_t)getUptime_ms();
+	case 8:		return sLatchedInputs;
+	case 9:		return (uint16_t)(sLatchTime_ms >> 16);
+	case 10:	return (uint16_t)sLatchTime_ms;
+	case 11:	return sLatchDelay_us;
+	default:	return 0;
+	}
+}
+
+
+static uint16_t holding_register(uint16_t inAddr){
+
+	enum PULSE_OUTPUT_PINS tmpPin = (enum PULSE_OUTPUT_PINS)(inAddr / MB_PULSE_REG_STRIDE);
+	uint16_t tmpFreq;
+	uint8_t tmpDuty;
+
+	otd_GetPulseFreqDuty(tmpPin, &tmpFreq, &tmpDuty);
+	switch (inAddr % MB_PULSE_REG_STRIDE){
+	case 0:		return tmpFreq;
+	case 1:		return tmpDuty;
+	case 2:		return otd_GetPulseEnabled(tmpPin);
+	case 3:		return otd_GetPulseCount(tmpPin);
+	case 4:		return otd_GetMaxPulseCount(tmpPin);
+	default:	return 0;
+	}
+}
+
+
+static uint8_t holding_check(uint16_t inAddr, uint16_t inValue){
+
+	switch (inAddr % MB_PULSE_REG_STRIDE){
+	case 0:
+		if (inValue < OTD_FREQ_MIN){
+			return OTD_MODBUS_EX_ILLEGAL_VALUE;
+		}
+		break;
+
+	case 1:
+		// otd_Pulse keeps the duty in 8 bits, so 256 is not accepted
+		if (inValue < OTD_DUTY_MIN || inValue > 255){
+			return OTD_MODBUS_EX_ILLEGAL_VALUE;
+		}
+		break;
+
+	case 2:
+		if (inValue > 1){
+			return OTD_MODBUS_EX_ILLEGAL_VALUE;
+		}
+		break;
+
+	case 3:
+		return OTD_MODBUS_EX_ILLEGAL_ADDRESS;
+
+	default:
+		break;
+	}
+
+	return OTD_MODBUS_EX_NONE;
+}
+
+
+static uint8_t holding_write(uint16_t inAddr, uint16_t inValue){
+
+	enum PULSE_OUTPUT_PINS tmpPin = (enum PULSE_OUTPUT_PINS)(inAddr / MB_PULSE_REG_STRIDE);
+	uint16_t tmpFreq;
+	uint8_t tmpDuty;
+
+	otd_GetPulseFreqDuty(tmpPin, &tmpFreq, &tmpDuty);
+	switch (inAddr % MB_PULSE_REG_STRIDE){
+	case 0:
+		// Duty is 50% until it is written
+		otd_SetPulseFreqDuty(tmpPin, inValue, (tmpDuty == 0) ? 128 : tmpDuty);
+		break;
+
+	case 1:
+		otd_SetPulseFreqDuty(tmpPin, (tmpFreq == 0) ? OTD_FREQ_MIN : tmpFreq, inValue);
+		break;
+
+	case 2:
+		if (otd_SetPulseEnabled(tmpPin, inValue) != 0){
+			return OTD_MODBUS_EX_DEVICE_FAILURE;
+		}
+		break;
+
+	case 4:
+		if (inValue == 0){
+			otd_ResetMaxPulseCount(tmpPin);
+		}else{
+			otd_SetMaxPulseCount(tmpPin, inValue);
+		}
+		break;
+
+	default:
+		break;
+	}
+
+	return OTD_MODBUS_EX_NONE;
+}
+
+
+static uint16_t modbus_crc(const uint8_t *inData, uint8_t inLength){
+
+	uint16_t tmpCrc = 0xFFFF;
+
+	for (uint8_t i = 0; i < inLength; i++){
+		tmpCrc = (tmpCrc >> 8) ^ pgm_read_word(&sCrcTable[(uint8_t)(tmpCrc ^ inData[i])]);
+	}
+
+	return tmpCrc;
+}
+
+
+// Modbus data is big endian
+static uint16_t get_u16(uint8_t inIndex){
+	return ((uint16_t)sFrame[inIndex] << 8) | sFrame[inIndex + 1];
+}
+
+
+static void put_u16(uint8_t inIndex, uint16_t inValue){
+
+	sFrame[inIndex] = (uint8_t)(inValue >> 8);
+	sFrame[inIndex + 1] = (uint8_t)inValue;
+
+	return;
+}
+
+
+
+#ifdef __cplusplus
+}
+#endif
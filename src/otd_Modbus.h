@@ -0,0 +1,101 @@
+/**
+  ******************************************************************************
+  * @file    otd_Modbus.h
+  * @author  OtomaDUINO Team
+  * @brief   This file contains Modbus RTU slave prototypes and data types.
+  ******************************************************************************
+  * @attention
+  *
+  * Copyright (c) 2022 ML-VPN.
+  * All rights reserved.
+  *
+  * This software is licensed under terms that can be found in the LICENSE file
+  * in the root directory of this software component.
+  * If no LICENSE file comes with this software, it is provided AS-IS.
+  *
+  ******************************************************************************
+  */
+
+#ifndef OTD_MODBUS_H_
+#define OTD_MODBUS_H_
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+#include <stdint.h>
+#include "otd_Analog.h"
+
+
+// Longest frame, request or response. 64 bytes allow 29 registers or 472 bits in one read
+#ifndef OTD_MODBUS_BUF_SIZE
+#define OTD_MODBUS_BUF_SIZE		64
+#endif
+
+
+/*
+ * ::: NOTE :::	Data model, all addresses are zero based:
+ * 				Discrete inputs	0..7	DIGITAL_INPUT_1..8 (otd_DigitalGetSnapshot)
+ * 				Coils			0..5	DIGITAL_OUTPUT_1..6 (otd_DigitalWrite), read only if left out by otd_ModbusSetCoilMask()
+ * 				Input registers	0..1	Last analog value, int32 in uV or uA, high word first
+ * 								2		Analog type (OTD_ANALOG_TYPE)
+ * 								3		Analog channel (OTD_ANALOG_CHANNEL)
+ * 								4		Analog sample counter, changes when a new value is given
+ * 								5		Digital inputs snapshot, bit 0 is DIGITAL_INPUT_1
+ * 								6..7	Uptime ms, high word first
+ * 								8		Digital inputs latched by "sample now", the last good latch
+ * 								9..10	Uptime ms when the latched inputs were read, high word first
+ * 								11		Latch delay us after the end of the "sample now" frame, 0xFFFF while the
+ * 										read runs or if it failed
+ * 				Holding registers, 5 per pulse output (PULSE_OUTPUT_1 at 0, PULSE_OUTPUT_2 at 5):
+ * 								+0		Frequency Hz (20..65535)
+ * 								+1		Duty cycle, x/256 (1..255)
+ * 								+2		Enabled (0/1), frequency and duty must be set first
+ * 								+3		Pulse count, read only
+ * 								+4		Maximum pulse count, 0 runs without limit
+ */
+enum OTD_MODBUS_EXCEPTION{
+	OTD_MODBUS_EX_NONE = 0,
+	OTD_MODBUS_EX_ILLEGAL_FUNCTION = 1,
+	OTD_MODBUS_EX_ILLEGAL_ADDRESS = 2,
+	OTD_MODBUS_EX_ILLEGAL_VALUE = 3,
+	OTD_MODBUS_EX_DEVICE_FAILURE = 4
+};
+
+
+struct OTD_MODBUS_STATS {
+	uint16_t frameCount;			// Frames addressed to us, broadcast included
+	uint16_t crcErrorCount;			// Short frames as well
+	uint16_t exceptionCount;
+	uint16_t overrunCount;			// Frames longer than OTD_MODBUS_BUF_SIZE
+};
+
+
+/*
+ * ::: NOTE :::	Frames end after 3.5 character times of silence, taken from the tick of the last received byte.
+ * 				Call otd_ModbusPoll() from the main loop at least every millisecond. The response is queued
+ * 				within "t3.5 + poll period" of the last request byte, and the UART sends it in the background.
+ * 				The UART address filter is enabled with the slave ID, so many boards can share an RS-485 line.
+ * 				Use otd_UartSetDirPin() for the driver enable and otd_NodeIdLoad() for a per board ID.
+ */
+int8_t otd_InitModbus(uint8_t inSlaveId);
+uint8_t otd_ModbusPoll();
+void otd_ModbusUpdateAnalog(union OTD_ANALOG_VALUE inValue);
+/*
+ * ::: NOTE :::	Function 0x41 "sample now" starts a read of the digital inputs as soon as the frame is taken and
+ * 				calls the hook. Sent to address 0, all boards start together and none of them answers. The read
+ * 				runs in the background with otd_DigitalReadAsync(), do not use that in the sketch meanwhile.
+ * 				otd_ModbusPoll() takes the result, the latch is done about 3ms after the frame. The latch delay
+ * 				tells each board's offset from the frame end, within one poll period.
+ */
+void otd_ModbusSetSampleHook(void (*inHook)(void));
+void otd_ModbusSetCoilMask(uint8_t inMask);
+void otd_ModbusGetStats(struct OTD_MODBUS_STATS *outStats);
+void otd_ModbusResetStats();
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* OTD_MODBUS_H_ */
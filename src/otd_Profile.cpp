@@ -0,0 +1,181 @@
+/**
+  ******************************************************************************
+  * @file    otd_Profile.cpp
+  * @author  OtomaDUINO Team
+  * @brief   This file contains interrupt timing instrumentation functions.
+  ******************************************************************************
+  * @attention
+  *
+  * Copyright (c) 2022 ML-VPN.
+  * All rights reserved.
+  *
+  * This software is licensed under terms that can be found in the LICENSE file
+  * in the root directory of this software component.
+  * If no LICENSE file comes with this software, it is provided AS-IS.
+  *
+  ******************************************************************************
+  */
+
+#include "otd_Profile.h"
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+
+#include "otd_CorePeri.h"
+#include "otd_Memory.h"
+
+
+static struct OTD_PROFILE_STATS sIsrStats[OTD_PROFILE_ISR_COUNT];
+static uint16_t sMaxCliCycles = 0;
+// Reported by otd_Memory
+const uint16_t otd_RamUsage_Profile = sizeof(sIsrStats);
+
+// Names are kept in flash, RAM is scarce
+static const char sIsrName[OTD_PROFILE_ISR_COUNT][14] PROGMEM = {
+	"ADC",
+	"ANALOG_COMP_1",
+	"PSC2_EC",
+	"PSC0_EC",
+	"TIMER1_OVF"
+};
+
+
+static void print_u32(uint32_t inValue);
+static void print_P(const char *inStr);
+
+
+
+void otd_InitProfile(){
+
+	uint8_t oldSREG = SREG;
+	cli();
+	memset(sIsrStats, 0, sizeof(sIsrStats));
+	sMaxCliCycles = 0;
+	SREG = oldSREG;
+
+	return;
+}
+
+
+
+void otd_ProfileGetIsr(enum OTD_PROFILE_ISR inIsr, struct OTD_PROFILE_STATS *outStats){
+
+	if (inIsr >= OTD_PROFILE_ISR_COUNT){
+		memset(outStats, 0, sizeof(struct OTD_PROFILE_STATS));
+		return;
+	}
+
+	uint8_t oldSREG = SREG;
+	cli();
+	*outStats = sIsrStats[inIsr];
+	SREG = oldSREG;
+
+	return;
+}
+
+
+
+uint16_t otd_ProfileGetMaxCli(){
+
+	uint16_t tmpCycles;
+
+	uint8_t oldSREG = SREG;
+	cli();
+	tmpCycles = sMaxCliCycles;
+	SREG = oldSREG;
+
+	return tmpCycles;
+}
+
+
+
+void otd_ProfileDump(){
+
+	struct OTD_PROFILE_STATS tmpStats;
+
+	if (OTD_PROFILE_ENABLE == 0){
+		otd_UartPrintln("PROFILE DISABLED");
+		return;
+	}
+
+	for (uint8_t i = 0; i < OTD_PROFILE_ISR_COUNT; i++){
+		otd_ProfileGetIsr((enum OTD_PROFILE_ISR)i, &tmpStats);
+
+		print_P(sIsrName[i]);
+		otd_UartPrint(" n=");
+		print_u32(tmpStats.count);
+		otd_UartPrint(" max=");
+		print_u32(tmpStats.maxCycles);
+		otd_UartPrint(" avg=");
+		print_u32((tmpStats.count == 0) ? 0 : tmpStats.totalCycles / tmpStats.count);
+		otd_UartPrint(" total=");
+		print_u32(tmpStats.totalCycles);
+		otd_UartPrintln("");
+	}
+	otd_UartPrint("CLI max=");
+	print_u32(otd_ProfileGetMaxCli());
+	otd_UartPrintln("");
+
+	return;
+}
+
+
+
+// Called from interrupt routines, interrupts are already masked
+void otd_ProfileIsrRecord(uint8_t inIsr, uint16_t inCycles){
+
+	struct OTD_PROFILE_STATS *curStats = &sIsrStats[inIsr];
+
+	curStats->count = curStats->count + 1;
+	curStats->totalCycles = curStats->totalCycles + inCycles;
+	if (inCycles > curStats->maxCycles){
+		curStats->maxCycles = inCycles;
+	}
+
+	return;
+}
+
+
+// Called with interrupts masked
+void otd_ProfileCliRecord(uint16_t inCycles){
+
+	if (inCycles > sMaxCliCycles){
+		sMaxCliCycles = inCycles;
+	}
+
+	return;
+}
+
+
+static void print_P(const char *inStr){
+
+	char c;
+	while ((c = pgm_read_byte(inStr++)) != 0){
+		otd_UartPrintByte(c);
+	}
+
+	return;
+}
+
+
+static void print_u32(uint32_t inValue){
+
+	char tmpStr[12];
+	ultoa(inValue, tmpStr, 10);
+	otd_UartPrint(tmpStr);
+
+	return;
+}
+
+
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,84 @@
+/**
+  ******************************************************************************
+  * @file    otd_Profile.h
+  * @author  OtomaDUINO Team
+  * @brief   This file contains interrupt timing instrumentation prototypes and data types.
+  ******************************************************************************
+  * @attention
+  *
+  * Copyright (c) 2022 ML-VPN.
+  * All rights reserved.
+  *
+  * This software is licensed under terms that can be found in the LICENSE file
+  * in the root directory of this software component.
+  * If no LICENSE file comes with this software, it is provided AS-IS.
+  *
+  ******************************************************************************
+  */
+
+#ifndef OTD_PROFILE_H_
+#define OTD_PROFILE_H_
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+#include <stdint.h>
+
+
+/*
+ * ::: NOTE :::	Set to 1 to record interrupt and masked section timings. When 0, the probes compile to nothing.
+ * 				Times are cycles of the free running Timer/Counter1. Interrupt prologue and epilogue are not included.
+ */
+#ifndef OTD_PROFILE_ENABLE
+#define OTD_PROFILE_ENABLE		0
+#endif
+
+
+enum OTD_PROFILE_ISR{
+	OTD_PROFILE_ISR_ADC = 0,
+	OTD_PROFILE_ISR_ANALOG_COMP_1,
+	OTD_PROFILE_ISR_PSC2_EC,
+	OTD_PROFILE_ISR_PSC0_EC,
+	OTD_PROFILE_ISR_TIMER1_OVF,
+	OTD_PROFILE_ISR_COUNT
+};
+
+
+struct OTD_PROFILE_STATS {
+	uint32_t count;
+	uint32_t totalCycles;
+	uint16_t maxCycles;
+};
+
+
+void otd_InitProfile();
+void otd_ProfileGetIsr(enum OTD_PROFILE_ISR inIsr, struct OTD_PROFILE_STATS *outStats);
+uint16_t otd_ProfileGetMaxCli();
+void otd_ProfileDump();
+// Used by the probes
+void otd_ProfileIsrRecord(uint8_t inIsr, uint16_t inCycles);
+void otd_ProfileCliRecord(uint16_t inCycles);
+
+
+#if OTD_PROFILE_ENABLE == 1
+#include "otd_Timebase.h"
+// Place at the start and the end of an interrupt routine. Cycle count stays continuous when the UART moves TCNT1
+#define OTD_PROFILE_ISR_ENTER()			uint16_t _profStart = otd_GetCycleCount()
+#define OTD_PROFILE_ISR_EXIT(isr)		otd_ProfileIsrRecord((isr), otd_GetCycleCount() - _profStart)
+// Place right after "cli()" and right before the interrupts are restored
+#define OTD_PROFILE_CLI_BEGIN()			uint16_t _profCliStart = otd_GetCycleCount()
+#define OTD_PROFILE_CLI_END()			otd_ProfileCliRecord(otd_GetCycleCount() - _profCliStart)
+#else
+#define OTD_PROFILE_ISR_ENTER()
+#define OTD_PROFILE_ISR_EXIT(isr)
+#define OTD_PROFILE_CLI_BEGIN()
+#define OTD_PROFILE_CLI_END()
+#endif
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* OTD_PROFILE_H_ */
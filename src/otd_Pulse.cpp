@@ -26,6 +26,7 @@ extern "C"{
 #include <avr/interrupt.h>
 
 #include "otd_CorePeri.h"
+#include "otd_Profile.h"
 
 #define PULSE_IN_CLOCK_HZ		8000000
 #define FREQ_RANGE_THRESH_HZ	4000
@@ -261,6 +262,12 @@ void otd_ResetMaxPulseCount(enum PULSE_OUTPUT_PINS inPulseOutPin){
 
 
 
+uint16_t otd_GetMaxPulseCount(enum PULSE_OUTPUT_PINS inPulseOutPin){
+	return sPulseMaxCount[inPulseOutPin];
+}
+
+
+
 uint16_t otd_GetPulseCount(enum PULSE_OUTPUT_PINS inPulseOutPin){
 	return sPulseCount[inPulseOutPin];
 }
@@ -269,6 +276,8 @@ uint16_t otd_GetPulseCount(enum PULSE_OUTPUT_PINS inPulseOutPin){
 
 // Pin 1 Pulse period end interrupt
 ISR(PSC2_EC_vect){
+	OTD_PROFILE_ISR_ENTER();
+
 	if (sPulseMaxCount[0] != 0){
 		// Increment pulse count
 		sPulseCount[0] = sPulseCount[0] +1;
@@ -278,11 +287,15 @@ ISR(PSC2_EC_vect){
 			PCTL2 &= ~(1<<PRUN2);
 		}
 	}
+
+	OTD_PROFILE_ISR_EXIT(OTD_PROFILE_ISR_PSC2_EC);
 }
 
 
 // Pin 2 Pulse period end interrupt
 ISR(PSC0_EC_vect){
+	OTD_PROFILE_ISR_ENTER();
+
 	if (sPulseMaxCount[1] != 0){
 		// Increment pulse count
 		sPulseCount[1] = sPulseCount[1] +1;
@@ -292,6 +305,8 @@ ISR(PSC0_EC_vect){
 			PCTL0 &= ~(1<<PRUN0);
 		}
 	}
+
+	OTD_PROFILE_ISR_EXIT(OTD_PROFILE_ISR_PSC0_EC);
 }
 
 
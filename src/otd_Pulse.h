@@ -46,6 +46,7 @@ void otd_GetPulseFreqDuty(enum PULSE_OUTPUT_PINS inPulseOutPin, uint16_t *outFre
 //
 void otd_SetMaxPulseCount(enum PULSE_OUTPUT_PINS inPulseOutPin, uint16_t inPulseMaxCount);
 void otd_ResetMaxPulseCount(enum PULSE_OUTPUT_PINS inPulseOutPin);
+uint16_t otd_GetMaxPulseCount(enum PULSE_OUTPUT_PINS inPulseOutPin);
 uint16_t otd_GetPulseCount(enum PULSE_OUTPUT_PINS inPulseOutPin);
 
 #ifdef __cplusplus
@@ -0,0 +1,248 @@
+/**
+  ******************************************************************************
+  * @file    otd_Scheduler.cpp
+  * @author  OtomaDUINO Team
+  * @brief   This file contains cooperative task scheduler functions.
+  ******************************************************************************
+  * @attention
+  *
+  * Copyright (c) 2022 ML-VPN.
+  * All rights reserved.
+  *
+  * This software is licensed under terms that can be found in the LICENSE file
+  * in the root directory of this software component.
+  * If no LICENSE file comes with this software, it is provided AS-IS.
+  *
+  ******************************************************************************
+  */
+
+#include "otd_Scheduler.h"
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <string.h>
+
+#include "otd_Timebase.h"
+#include "otd_Memory.h"
+
+
+struct sched_task {
+	void (*task)(void);
+	uint16_t period_ms;
+	volatile uint16_t countdown_ms;
+	uint8_t priority;
+	uint8_t isEnabled;
+	volatile uint8_t isReady;
+	volatile uint32_t release_us;
+	struct OTD_SCHED_STATS stats;
+};
+
+static struct sched_task sTask[OTD_SCHED_MAX_TASKS];
+static uint8_t sTaskCount = 0;
+static uint8_t sIsHooked = 0;
+// Reported by otd_Memory
+const uint16_t otd_RamUsage_Scheduler = sizeof(sTask);
+
+
+static void sched_tick();
+static uint16_t saturate16(uint32_t inValue);
+
+
+
+void otd_InitScheduler(){
+
+	uint8_t oldSREG = SREG;
+	cli();
+	memset(sTask, 0, sizeof(sTask));
+	sTaskCount = 0;
+	SREG = oldSREG;
+
+	// Tasks are released on every millisecond
+	if (sIsHooked == 0){
+		if (otd_AddMsHook(sched_tick) == 0){
+			sIsHooked = 1;
+		}
+	}
+
+	return;
+}
+
+
+
+int8_t otd_SchedAddTask(void (*inTask)(void), uint16_t inPeriod_ms, uint16_t inPhase_ms, uint8_t inPriority){
+
+	int8_t taskId = -1;
+
+	if (inTask == 0 || inPeriod_ms == 0){
+		return -1;
+	}
+
+	uint8_t oldSREG = SREG;
+	cli();
+	if (sTaskCount < OTD_SCHED_MAX_TASKS){
+		taskId = sTaskCount;
+		memset(&sTask[taskId], 0, sizeof(struct sched_task));
+		sTask[taskId].task = inTask;
+		sTask[taskId].period_ms = inPeriod_ms;
+		// First release is "inPhase_ms" later. Use it to spread tasks with the same period
+		sTask[taskId].countdown_ms = (inPhase_ms == 0) ? 1 : inPhase_ms;
+		sTask[taskId].priority = inPriority;
+		sTask[taskId].isEnabled = 1;
+		sTaskCount = sTaskCount + 1;
+	}
+	SREG = oldSREG;
+
+	return taskId;
+}
+
+
+
+void otd_SchedSetTaskEnabled(uint8_t inTaskId, uint8_t inIsEnabled){
+
+	if (inTaskId >= sTaskCount){
+		return;
+	}
+
+	uint8_t oldSREG = SREG;
+	cli();
+	sTask[inTaskId].isEnabled = (inIsEnabled != 0);
+	sTask[inTaskId].isReady = 0;
+	sTask[inTaskId].countdown_ms = sTask[inTaskId].period_ms;
+	SREG = oldSREG;
+
+	return;
+}
+
+
+
+uint8_t otd_SchedRun(){
+
+	uint8_t runCount = 0;
+
+	while (1){
+		// Find the ready task with the highest priority
+		uint8_t curId = OTD_SCHED_MAX_TASKS;
+		for (uint8_t i = 0; i < sTaskCount; i++){
+			if (sTask[i].isReady == 0){
+				continue;
+			}
+			if (curId == OTD_SCHED_MAX_TASKS || sTask[i].priority < sTask[curId].priority){
+				curId = i;
+			}
+		}
+		if (curId == OTD_SCHED_MAX_TASKS){
+			break;
+		}
+
+		// Take the release time and clear ready flag together
+		uint32_t releaseTS;
+		uint8_t oldSREG = SREG;
+		cli();
+		releaseTS = sTask[curId].release_us;
+		sTask[curId].isReady = 0;
+		SREG = oldSREG;
+
+		uint32_t startTS = getUptime_us();
+		sTask[curId].task();
+		uint32_t endTS = getUptime_us();
+
+		// Update statistics
+		struct OTD_SCHED_STATS *curStats = &sTask[curId].stats;
+		uint16_t tmpJitter = saturate16(startTS - releaseTS);
+		uint16_t tmpExec = saturate16(endTS - startTS);
+		if (tmpJitter > curStats->maxJitter_us){
+			curStats->maxJitter_us = tmpJitter;
+		}
+		if (tmpExec > curStats->maxExec_us){
+			curStats->maxExec_us = tmpExec;
+		}
+		curStats->runCount = curStats->runCount + 1;
+
+		runCount = runCount + 1;
+	}
+
+	return runCount;
+}
+
+
+
+void otd_SchedGetStats(uint8_t inTaskId, struct OTD_SCHED_STATS *outStats){
+
+	if (inTaskId >= sTaskCount){
+		memset(outStats, 0, sizeof(struct OTD_SCHED_STATS));
+		return;
+	}
+
+	// Overrun count is updated from the tick interrupt
+	uint8_t oldSREG = SREG;
+	cli();
+	*outStats = sTask[inTaskId].stats;
+	SREG = oldSREG;
+
+	return;
+}
+
+
+
+void otd_SchedResetStats(uint8_t inTaskId){
+
+	if (inTaskId >= sTaskCount){
+		return;
+	}
+
+	uint8_t oldSREG = SREG;
+	cli();
+	memset(&sTask[inTaskId].stats, 0, sizeof(struct OTD_SCHED_STATS));
+	SREG = oldSREG;
+
+	return;
+}
+
+
+
+// Called from the tick interrupt on every millisecond
+static void sched_tick(){
+
+	for (uint8_t i = 0; i < sTaskCount; i++){
+		struct sched_task *curTask = &sTask[i];
+		if (curTask->isEnabled == 0){
+			continue;
+		}
+
+		uint16_t tmpCountdown = curTask->countdown_ms - 1;
+		if (tmpCountdown != 0){
+			curTask->countdown_ms = tmpCountdown;
+			continue;
+		}
+		curTask->countdown_ms = curTask->period_ms;
+
+		if (curTask->isReady){
+			// Previous release did not run yet
+			curTask->stats.overrunCount = curTask->stats.overrunCount + 1;
+		}else{
+			curTask->release_us = getUptime_us();
+			curTask->isReady = 1;
+		}
+	}
+
+	return;
+}
+
+
+static uint16_t saturate16(uint32_t inValue){
+
+	if (inValue > 0xFFFF){
+		return 0xFFFF;
+	}
+	return (uint16_t)inValue;
+}
+
+
+
+#ifdef __cplusplus
+}
+#endif
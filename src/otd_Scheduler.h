@@ -0,0 +1,58 @@
+/**
+  ******************************************************************************
+  * @file    otd_Scheduler.h
+  * @author  OtomaDUINO Team
+  * @brief   This file contains cooperative task scheduler functions prototypes and data types.
+  ******************************************************************************
+  * @attention
+  *
+  * Copyright (c) 2022 ML-VPN.
+  * All rights reserved.
+  *
+  * This software is licensed under terms that can be found in the LICENSE file
+  * in the root directory of this software component.
+  * If no LICENSE file comes with this software, it is provided AS-IS.
+  *
+  ******************************************************************************
+  */
+
+#ifndef OTD_SCHEDULER_H_
+#define OTD_SCHEDULER_H_
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+#include <stdint.h>
+
+
+#ifndef OTD_SCHED_MAX_TASKS
+#define OTD_SCHED_MAX_TASKS		4
+#endif
+
+
+/*
+ * ::: NOTE :::	Tasks are released by the millisecond tick and run from otd_SchedRun() in the main loop.
+ * 				Lower priority number runs first. A task released again before it could run counts as an overrun.
+ */
+struct OTD_SCHED_STATS {
+	uint32_t runCount;
+	uint16_t maxJitter_us;		// Release to start delay
+	uint16_t maxExec_us;		// Worst case execution time
+	uint16_t overrunCount;
+};
+
+
+void otd_InitScheduler();
+int8_t otd_SchedAddTask(void (*inTask)(void), uint16_t inPeriod_ms, uint16_t inPhase_ms, uint8_t inPriority);
+void otd_SchedSetTaskEnabled(uint8_t inTaskId, uint8_t inIsEnabled);
+uint8_t otd_SchedRun();
+void otd_SchedGetStats(uint8_t inTaskId, struct OTD_SCHED_STATS *outStats);
+void otd_SchedResetStats(uint8_t inTaskId);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* OTD_SCHEDULER_H_ */
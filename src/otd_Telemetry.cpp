@@ -0,0 +1,185 @@
+/**
+  ******************************************************************************
+  * @file    otd_Telemetry.cpp
+  * @author  OtomaDUINO Team
+  * @brief   This file contains binary telemetry framing functions.
+  ******************************************************************************
+  * @attention
+  *
+  * Copyright (c) 2022 ML-VPN.
+  * All rights reserved.
+  *
+  * This software is licensed under terms that can be found in the LICENSE file
+  * in the root directory of this software component.
+  * If no LICENSE file comes with this software, it is provided AS-IS.
+  *
+  ******************************************************************************
+  */
+
+#include "otd_Telemetry.h"
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+#include <avr/io.h>
+#include <util/crc16.h>
+
+#include "otd_CorePeri.h"
+#include "otd_Timebase.h"
+
+
+#define TLM_HEADER_SIZE		4
+#define TLM_CRC_SIZE		2
+#define TLM_FRAME_MAX		(TLM_HEADER_SIZE + OTD_TLM_MAX_PAYLOAD + TLM_CRC_SIZE)
+// COBS adds one byte per 254 bytes, a frame fits in one block
+static_assert(TLM_FRAME_MAX < 254, "Telemetry frame must fit in one COBS block");
+
+static uint8_t sSequence = 0;
+
+
+static uint8_t cobs_encode(const uint8_t *inData, uint8_t inLength, uint8_t *outData);
+static void put_u16(uint8_t *outData, uint16_t inValue);
+
+
+
+void otd_InitTelemetry(){
+
+	sSequence = 0;
+
+	return;
+}
+
+
+
+void otd_TlmSendAnalog(uint8_t inChannel, uint8_t inAnalogType, int32_t inValue){
+
+	uint8_t tmpPayload[6];
+
+	tmpPayload[0] = inChannel;
+	tmpPayload[1] = inAnalogType;
+	put_u16(&tmpPayload[2], (uint16_t)inValue);
+	put_u16(&tmpPayload[4], (uint16_t)((uint32_t)inValue >> 16));
+
+	otd_TlmSendRecord(OTD_TLM_REC_ANALOG, tmpPayload, sizeof(tmpPayload));
+	return;
+}
+
+
+
+void otd_TlmSendDigital(uint8_t inInputs, uint8_t inOutputs){
+
+	uint8_t tmpPayload[2];
+
+	tmpPayload[0] = inInputs;
+	tmpPayload[1] = inOutputs;
+
+	otd_TlmSendRecord(OTD_TLM_REC_DIGITAL, tmpPayload, sizeof(tmpPayload));
+	return;
+}
+
+
+
+void otd_TlmSendPulse(uint8_t inPin, uint16_t inFreq, uint8_t inDuty, uint16_t inCount){
+
+	uint8_t tmpPayload[6];
+
+	tmpPayload[0] = inPin;
+	put_u16(&tmpPayload[1], inFreq);
+	tmpPayload[3] = inDuty;
+	put_u16(&tmpPayload[4], inCount);
+
+	otd_TlmSendRecord(OTD_TLM_REC_PULSE, tmpPayload, sizeof(tmpPayload));
+	return;
+}
+
+
+
+int8_t otd_TlmSendRecord(uint8_t inRecordType, const uint8_t *inPayload, uint8_t inLength){
+
+	uint8_t tmpFrame[TLM_FRAME_MAX];
+	uint8_t tmpEncoded[TLM_FRAME_MAX + 1];
+	uint8_t frameLength = 0;
+	uint16_t tmpCrc = 0xFFFF;
+
+	if (inLength > OTD_TLM_MAX_PAYLOAD){
+		return -1;
+	}
+
+	// Header
+	tmpFrame[0] = sSequence;
+	tmpFrame[1] = inRecordType;
+	put_u16(&tmpFrame[2], (uint16_t)getUptime_ms());
+	frameLength = TLM_HEADER_SIZE;
+	for (uint8_t i = 0; i < inLength; i++){
+		tmpFrame[frameLength++] = inPayload[i];
+	}
+
+	// CRC-16/CCITT-FALSE: polynomial 0x1021, initial value 0xFFFF, no reflection
+	for (uint8_t i = 0; i < frameLength; i++){
+		tmpCrc = _crc_xmodem_update(tmpCrc, tmpFrame[i]);
+	}
+	put_u16(&tmpFrame[frameLength], tmpCrc);
+	frameLength = frameLength + TLM_CRC_SIZE;
+
+	// Encode and send with the delimiter. UART sends it in the background
+	uint8_t encodedLength = cobs_encode(tmpFrame, frameLength, tmpEncoded);
+	for (uint8_t i = 0; i < encodedLength; i++){
+		otd_UartPrintByte(tmpEncoded[i]);
+	}
+	otd_UartPrintByte(0x00);
+
+	sSequence = sSequence + 1;
+
+	return 0;
+}
+
+
+
+uint8_t otd_TlmGetSequence(){
+	return sSequence;
+}
+
+
+
+/*
+ * ::: NOTE :::	Consistent Overhead Byte Stuffing. Every zero is replaced with the distance to the next zero,
+ * 				and the first byte is the distance to the first zero. "outData" needs "inLength + 1" bytes.
+ */
+static uint8_t cobs_encode(const uint8_t *inData, uint8_t inLength, uint8_t *outData){
+
+	uint8_t codeIndex = 0;
+	uint8_t outIndex = 1;
+	uint8_t code = 1;
+
+	for (uint8_t i = 0; i < inLength; i++){
+		if (inData[i] == 0){
+			outData[codeIndex] = code;
+			codeIndex = outIndex;
+			outIndex = outIndex + 1;
+			code = 1;
+		}else{
+			outData[outIndex] = inData[i];
+			outIndex = outIndex + 1;
+			code = code + 1;
+		}
+	}
+	outData[codeIndex] = code;
+
+	return outIndex;
+}
+
+
+static void put_u16(uint8_t *outData, uint16_t inValue){
+
+	outData[0] = (uint8_t)inValue;
+	outData[1] = (uint8_t)(inValue >> 8);
+
+	return;
+}
+
+
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,61 @@
+/**
+  ******************************************************************************
+  * @file    otd_Telemetry.h
+  * @author  OtomaDUINO Team
+  * @brief   This file contains binary telemetry framing prototypes and data types.
+  ******************************************************************************
+  * @attention
+  *
+  * Copyright (c) 2022 ML-VPN.
+  * All rights reserved.
+  *
+  * This software is licensed under terms that can be found in the LICENSE file
+  * in the root directory of this software component.
+  * If no LICENSE file comes with this software, it is provided AS-IS.
+  *
+  ******************************************************************************
+  */
+
+#ifndef OTD_TELEMETRY_H_
+#define OTD_TELEMETRY_H_
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+#include <stdint.h>
+
+
+// Largest record payload in bytes
+#define OTD_TLM_MAX_PAYLOAD		16
+
+
+/*
+ * ::: NOTE :::	Frame before encoding, multi-byte fields are little endian:
+ * 				[seq u8][record type u8][time ms u16][payload ...][CRC-16/CCITT-FALSE u16]
+ * 				CRC covers everything before it. Frame is COBS encoded, so it has no zero bytes,
+ * 				and a single 0x00 ends it. A lost byte costs one frame only, the decoder syncs on the next 0x00.
+ * 				"time ms" is the low 16 bits of getUptime_ms(). Sequence number shows lost frames.
+ * 				A decoder is in "extras/otd_telemetry.py".
+ */
+enum OTD_TLM_RECORD{
+	OTD_TLM_REC_ANALOG = 1,			// [channel u8][analog type u8][value i32], uV or uA
+	OTD_TLM_REC_DIGITAL,			// [inputs u8][outputs u8], bit 0 is pin 1
+	OTD_TLM_REC_PULSE,				// [pin u8][freq Hz u16][duty u8][count u16]
+	OTD_TLM_REC_USER = 0x80			// Application records are 0x80 and above
+};
+
+
+void otd_InitTelemetry();
+void otd_TlmSendAnalog(uint8_t inChannel, uint8_t inAnalogType, int32_t inValue);
+void otd_TlmSendDigital(uint8_t inInputs, uint8_t inOutputs);
+void otd_TlmSendPulse(uint8_t inPin, uint16_t inFreq, uint8_t inDuty, uint16_t inCount);
+int8_t otd_TlmSendRecord(uint8_t inRecordType, const uint8_t *inPayload, uint8_t inLength);
+uint8_t otd_TlmGetSequence();
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* OTD_TELEMETRY_H_ */
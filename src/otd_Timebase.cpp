@@ -0,0 +1,659 @@
+/**
+  ******************************************************************************
+  * @file    otd_Timebase.cpp
+  * @author  OtomaDUINO Team
+  * @brief   This file contains uptime clock and cycle counter functions.
+  ******************************************************************************
+  * @attention
+  *
+  * Copyright (c) 2022 ML-VPN.
+  * All rights reserved.
+  *
+  * This software is licensed under terms that can be found in the LICENSE file
+  * in the root directory of this software component.
+  * If no LICENSE file comes with this software, it is provided AS-IS.
+  *
+  ******************************************************************************
+  */
+
+#include "otd_Timebase.h"
+#include "otd_Profile.h"
+#include "otd_Memory.h"
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/eeprom.h>
+#include <avr/sleep.h>
+#include <util/delay.h>
+
+
+/*
+ * DECLARATION OF STATIC FUNCTIONS
+ */
+static void init_timer_adc();
+static void init_cycle_counter();
+static uint32_t div_q16(uint32_t inNum, uint32_t inDen);
+
+
+/*
+ * TIMER (ADC) DEFINITIONS
+ */
+#define ADC_CH_AMP0					11
+/*
+ * ::: NOTE :::	I/O PLL input clock can be maximum 8MHz. So, by using Fuse bits internal RC OSC was used.
+ * 				The ADC prescaler value "128" was used. Hence, in free running mode ADC conversion takes
+ * 				"16" ADC clock cycles (8Mhz/128) results in 4KHz ADC completed interrupt.
+ */
+#define ADC_SAMPLING_PERIOD_US		OTD_TICK_PERIOD_US
+#define CYCLES_PER_US				(F_CPU/1000000UL)
+// Tick period in 16.16 fixed point microseconds
+#define TICK_PERIOD_Q16_NOMINAL		((uint32_t)ADC_SAMPLING_PERIOD_US << 16)
+#define TICK_PERIOD_Q16_MIN			(TICK_PERIOD_Q16_NOMINAL - TICK_PERIOD_Q16_NOMINAL/10)
+#define TICK_PERIOD_Q16_MAX			(TICK_PERIOD_Q16_NOMINAL + TICK_PERIOD_Q16_NOMINAL/10)
+// Cycles between reading and writing back TCNT1 in otd_CycleTimerReload(), estimated. Not an exact count
+#define TCNT1_RELOAD_LATENCY		10
+// A reload which comes too late overflows this many cycles later, instead of after a whole counter turn
+#define TCNT1_RELOAD_MIN			16
+
+/*
+ * ::: NOTE :::	All uptime counters are advanced incrementally in the tick interrupt, so readers only
+ * 				copy them. 32 bit values are read with interrupts masked since the AVR loads them byte by byte.
+ */
+static volatile uint32_t sUptimeTick = 0;
+static volatile uint32_t sUptimeMs = 0;
+static volatile uint32_t sUptimeUs = 0;
+static volatile uint16_t sMsFraction_us = 0;	// Microseconds collected towards the next millisecond
+static volatile uint16_t sTickStamp = 0;		// Cycle counter value at the last tick
+static volatile uint16_t sUsFraction = 0;		// Sub-microsecond part of the uptime, 1/65536 us
+/*
+ * ::: NOTE :::	When TCNT1 is moved by the bit timer, the jump is added here. So, "TCNT1 + sCycleSkew"
+ * 				is a cycle counter which never jumps. Tick stamp is taken from it as well.
+ */
+static volatile uint16_t sCycleSkew = 0;
+/*
+ * ::: NOTE :::	ADC runs on the internal RC oscillator, so the real tick is a little off from 128us and drifts.
+ * 				The calibrated tick period is split into whole and fraction parts, the tick only adds them.
+ */
+static uint8_t sTickWhole_us = ADC_SAMPLING_PERIOD_US;
+static uint16_t sTickFraction = 0;
+/*
+ * ::: NOTE :::	CPU load is sampled by the tick: a tick which wakes the CPU from otd_Idle() is an idle tick.
+ * 				Load is taken over windows of 1024 ticks (~131ms) so that it needs a shift instead of a divide.
+ */
+#define LOAD_WINDOW_TICKS			1024
+static volatile uint8_t sIsSleeping = 0;
+static uint8_t sIdleMode = OTD_IDLE_MODE_IDLE;
+static void (*sIdleHook)(void) = 0;
+static volatile uint32_t sIdleTicks = 0;
+static uint16_t sWindowIdleTicks = 0;
+static volatile uint16_t sLastWindowIdleTicks = 0;
+//
+static volatile uint8_t sCalibIsActive = 0;
+static uint8_t sCalibSource = OTD_CALIB_SRC_UART_RX;
+static uint16_t sCalibRefPeriod_ms = 0;
+static volatile uint16_t sCalibEdgeCount = 0;
+static volatile uint32_t sCalibFirstTick = 0;
+static volatile uint32_t sCalibLastTick = 0;
+//
+static void (*sMsHook[OTD_MS_HOOK_MAX])(void);
+static uint8_t sMsHookCount = 0;
+static void (*sTickHook[OTD_TICK_HOOK_MAX])(void);
+static uint8_t sTickHookCount = 0;
+// Reported by otd_Memory
+const uint16_t otd_RamUsage_Timebase = sizeof(sMsHook) + sizeof(sTickHook);
+
+
+
+
+void otd_InitTimebase(){
+
+	// Reset counters
+	sUptimeTick = 0;
+	sUptimeMs = 0;
+	sUptimeUs = 0;
+	sMsFraction_us = 0;
+	sUsFraction = 0;
+
+	// Used for sub-tick resolution
+	init_cycle_counter();
+	// Used as the system tick
+	init_timer_adc();
+
+	return;
+}
+
+
+
+/*
+ * UPTIME FUNCTIONS
+ */
+unsigned long getUptime_ms(){
+
+	uint32_t tmpMs;
+
+	uint8_t oldSREG = SREG;
+	cli();
+	OTD_PROFILE_CLI_BEGIN();
+	tmpMs = sUptimeMs;
+	OTD_PROFILE_CLI_END();
+	SREG = oldSREG;
+
+	return tmpMs;
+}
+
+
+uint32_t getUptime_us(){
+
+	uint32_t tmpUs;
+	uint16_t tmpElapsed;
+
+	uint8_t oldSREG = SREG;
+	cli();
+	OTD_PROFILE_CLI_BEGIN();
+	tmpUs = sUptimeUs;
+	tmpElapsed = (uint16_t)(TCNT1 + sCycleSkew - sTickStamp) / CYCLES_PER_US;
+	/*
+	 * ::: NOTE :::	ADC conversion progress can not be read back, so the time elapsed since the last tick
+	 * 				is taken from the free running cycle counter stamped in the tick interrupt.
+	 */
+	if (ADCSRA & _BV(ADIF)){
+		// A tick has completed but its interrupt is not served yet (we are called with interrupts masked)
+		tmpUs += sTickWhole_us;
+		tmpElapsed = 0;
+	}else if (tmpElapsed >= sTickWhole_us){
+		// Interrupt latency of the last tick. Clamp so that reads never go backwards
+		tmpElapsed = sTickWhole_us - 1;
+	}
+	OTD_PROFILE_CLI_END();
+	SREG = oldSREG;
+
+	return tmpUs + tmpElapsed;
+}
+
+
+uint32_t getUptime_ticks(){
+
+	uint32_t tmpTick;
+
+	uint8_t oldSREG = SREG;
+	cli();
+	OTD_PROFILE_CLI_BEGIN();
+	tmpTick = sUptimeTick;
+	OTD_PROFILE_CLI_END();
+	SREG = oldSREG;
+
+	return tmpTick;
+}
+
+
+void getUptime(struct OTD_UPTIME *outUptime){
+
+	// All counters are taken from the same tick
+	uint8_t oldSREG = SREG;
+	cli();
+	OTD_PROFILE_CLI_BEGIN();
+	outUptime->tick = sUptimeTick;
+	outUptime->ms = sUptimeMs;
+	outUptime->us = sUptimeUs;
+	OTD_PROFILE_CLI_END();
+	SREG = oldSREG;
+
+	return;
+}
+
+
+uint16_t otd_GetCycleCount(){
+
+	uint16_t tmpCycles;
+
+	// 16 bit timer registers share a temp register, so do not let an interrupt in between
+	uint8_t oldSREG = SREG;
+	cli();
+	tmpCycles = TCNT1 + sCycleSkew;
+	SREG = oldSREG;
+
+	return tmpCycles;
+}
+
+
+// Next overflow comes "inCycles" later from now
+void otd_CycleTimerStart(uint16_t inCycles){
+
+	uint16_t tmpNow = TCNT1;
+	uint16_t tmpNew = (uint16_t)(0 - inCycles);
+
+	TCNT1 = tmpNew;
+	sCycleSkew = sCycleSkew + (uint16_t)(tmpNow - tmpNew);
+	TIFR1 = _BV(TOV1);			// Clear a stale overflow
+
+	return;
+}
+
+
+// Next overflow comes "inCycles" later from the last overflow. Call from the overflow interrupt
+void otd_CycleTimerReload(uint16_t inCycles){
+
+	/*
+	 * ::: NOTE :::	Counter is moved back relative to its current value, so interrupt latency does
+	 * 				not add up from bit to bit. Only the read-modify-write time is compensated.
+	 */
+	uint16_t tmpNow = TCNT1;
+	uint16_t tmpNew = tmpNow + (uint16_t)(TCNT1_RELOAD_LATENCY - inCycles);
+	if ((int16_t)tmpNew > -TCNT1_RELOAD_MIN){
+		// Overflow interrupt was held off longer than the period
+		tmpNew = (uint16_t)(0 - TCNT1_RELOAD_MIN);
+	}
+
+	TCNT1 = tmpNew;
+	sCycleSkew = sCycleSkew + (uint16_t)(tmpNow + TCNT1_RELOAD_LATENCY - tmpNew);
+
+	return;
+}
+
+
+
+int8_t otd_AddMsHook(void (*inHook)(void)){
+
+	int8_t retVal = -1;
+
+	uint8_t oldSREG = SREG;
+	cli();
+	if (sMsHookCount < OTD_MS_HOOK_MAX){
+		sMsHook[sMsHookCount] = inHook;
+		sMsHookCount = sMsHookCount + 1;
+		retVal = 0;
+	}
+	SREG = oldSREG;
+
+	return retVal;
+}
+
+
+
+int8_t otd_AddTickHook(void (*inHook)(void)){
+
+	int8_t retVal = -1;
+
+	uint8_t oldSREG = SREG;
+	cli();
+	if (sTickHookCount < OTD_TICK_HOOK_MAX){
+		sTickHook[sTickHookCount] = inHook;
+		sTickHookCount = sTickHookCount + 1;
+		retVal = 0;
+	}
+	SREG = oldSREG;
+
+	return retVal;
+}
+
+
+
+
+/*
+ * IDLE FUNCTIONS
+ */
+void otd_SetIdleMode(enum OTD_IDLE_MODE inIdleMode){
+
+	switch (inIdleMode){
+	case OTD_IDLE_MODE_IDLE:
+	case OTD_IDLE_MODE_ADC_NR:
+		break;
+
+	default:
+		return;
+	}
+
+	sIdleMode = inIdleMode;
+	return;
+}
+
+
+void otd_SetIdleHook(void (*inHook)(void)){
+	sIdleHook = inHook;
+	return;
+}
+
+
+void otd_Idle(){
+
+	// Application work before sleeping, e.g. watchdog reset
+	if (sIdleHook != 0){
+		sIdleHook();
+	}
+
+	/*
+	 * ::: NOTE :::	ADC noise reduction stops the IO clock. Pulse outputs (PSC) run from it, so they would
+	 * 				stop. Also, the cycle counter and the bit timer (soft UART) do not count during that sleep.
+	 */
+	if (sIdleMode == OTD_IDLE_MODE_ADC_NR
+			&& (PCTL0 & _BV(PRUN0)) == 0
+			&& (PCTL2 & _BV(PRUN2)) == 0
+			&& (TIMSK1 & _BV(TOIE1)) == 0){
+		set_sleep_mode(SLEEP_MODE_ADC);
+	}else{
+		set_sleep_mode(SLEEP_MODE_IDLE);
+	}
+
+	// Any enabled interrupt wakes up. The ADC tick does so at least once a tick period
+	cli();
+	sIsSleeping = 1;
+	sleep_enable();
+	sei();
+	sleep_cpu();		// "sei" lets one more instruction run first, so a pending interrupt can not be missed
+	sleep_disable();
+	sIsSleeping = 0;
+
+	return;
+}
+
+
+uint32_t otd_GetIdleTicks(){
+
+	uint32_t tmpTicks;
+
+	uint8_t oldSREG = SREG;
+	cli();
+	tmpTicks = sIdleTicks;
+	SREG = oldSREG;
+
+	return tmpTicks;
+}
+
+
+// Returns CPU load of the last window in per mille
+uint16_t otd_GetCpuLoad(){
+
+	uint16_t tmpIdle;
+
+	uint8_t oldSREG = SREG;
+	cli();
+	tmpIdle = sLastWindowIdleTicks;
+	SREG = oldSREG;
+
+	return ((uint32_t)(LOAD_WINDOW_TICKS - tmpIdle) * 1000UL) / LOAD_WINDOW_TICKS;
+}
+
+
+
+
+/*
+ * CALIBRATION FUNCTIONS
+ */
+void otd_TimebaseCalibStart(enum OTD_CALIB_SOURCE inSource, uint16_t inRefPeriod_ms){
+
+	uint8_t oldSREG = SREG;
+	cli();
+	sCalibSource = inSource;
+	sCalibRefPeriod_ms = inRefPeriod_ms;
+	sCalibEdgeCount = 0;
+	sCalibIsActive = 1;
+	SREG = oldSREG;
+
+	return;
+}
+
+
+void otd_TimebaseCalibEdge(enum OTD_CALIB_SOURCE inSource){
+
+	// ::: NOTE :::	Also called from interrupts, so it must stay short
+	if (sCalibIsActive == 0 || inSource != sCalibSource){
+		return;
+	}
+
+	uint32_t tmpTick = getUptime_ticks();
+
+	uint8_t oldSREG = SREG;
+	cli();
+	if (sCalibEdgeCount == 0){
+		sCalibFirstTick = tmpTick;
+	}
+	sCalibLastTick = tmpTick;
+	if (sCalibEdgeCount != 0xFFFF){
+		sCalibEdgeCount = sCalibEdgeCount + 1;
+	}
+	SREG = oldSREG;
+
+	return;
+}
+
+
+uint16_t otd_TimebaseCalibEdgeCount(){
+
+	uint16_t tmpCount;
+
+	uint8_t oldSREG = SREG;
+	cli();
+	tmpCount = sCalibEdgeCount;
+	SREG = oldSREG;
+
+	return tmpCount;
+}
+
+
+int8_t otd_TimebaseCalibFinish(){
+
+	uint16_t tmpEdgeCount;
+	uint32_t tmpTicks;
+
+	uint8_t oldSREG = SREG;
+	cli();
+	sCalibIsActive = 0;
+	tmpEdgeCount = sCalibEdgeCount;
+	tmpTicks = sCalibLastTick - sCalibFirstTick;
+	SREG = oldSREG;
+
+	/*
+	 * ::: NOTE :::	Measurement resolution is one tick on each end. Use a reference window of minutes
+	 * 				to get down to a few ppm. Reference time must stay below ~71 minutes.
+	 */
+	if (tmpEdgeCount < 2 || tmpTicks == 0 || sCalibRefPeriod_ms == 0){
+		return -1;
+	}
+	uint32_t tmpRefPeriods = tmpEdgeCount - 1;
+	if (tmpRefPeriods > (0xFFFFFFFFUL/1000UL) / sCalibRefPeriod_ms){
+		return -1;
+	}
+	uint32_t tmpRef_us = tmpRefPeriods * sCalibRefPeriod_ms * 1000UL;
+
+	// Real tick period = reference time / measured ticks. Division is done here once, not at read time
+	return otd_SetTimebaseTrim(div_q16(tmpRef_us, tmpTicks));
+}
+
+
+int8_t otd_SetTimebaseTrim(uint32_t inTickPeriod_q16){
+
+	// Reject values far from the nominal tick, a wrong reference would give these
+	if (inTickPeriod_q16 < TICK_PERIOD_Q16_MIN || inTickPeriod_q16 > TICK_PERIOD_Q16_MAX){
+		return -1;
+	}
+
+	uint8_t oldSREG = SREG;
+	cli();
+	sTickWhole_us = (uint8_t)(inTickPeriod_q16 >> 16);
+	sTickFraction = (uint16_t)inTickPeriod_q16;
+	SREG = oldSREG;
+
+	return 0;
+}
+
+
+uint32_t otd_GetTimebaseTrim(){
+	return ((uint32_t)sTickWhole_us << 16) | sTickFraction;
+}
+
+
+int8_t otd_TimebaseTrimLoad(){
+
+	uint32_t tmpTrim = eeprom_read_dword((const uint32_t *)OTD_EEADDR_TIMEBASE_TRIM);
+	uint16_t tmpCheck = eeprom_read_word((const uint16_t *)(OTD_EEADDR_TIMEBASE_TRIM + 4));
+
+	// Erased or corrupted EEPROM fails the check
+	if (tmpCheck != (uint16_t)~((uint16_t)tmpTrim ^ (uint16_t)(tmpTrim >> 16))){
+		return -1;
+	}
+
+	return otd_SetTimebaseTrim(tmpTrim);
+}
+
+
+void otd_TimebaseTrimSave(){
+
+	uint32_t tmpTrim = otd_GetTimebaseTrim();
+	uint16_t tmpCheck = ~((uint16_t)tmpTrim ^ (uint16_t)(tmpTrim >> 16));
+
+	eeprom_update_dword((uint32_t *)OTD_EEADDR_TIMEBASE_TRIM, tmpTrim);
+	eeprom_update_word((uint16_t *)(OTD_EEADDR_TIMEBASE_TRIM + 4), tmpCheck);
+
+	return;
+}
+
+
+// Returns inNum/inDen in 16.16 fixed point. Whole part by division, the 16 fraction bits by shift and
+// subtract, so no 64 bit division is needed. Quotient must fit in 16 bits
+static uint32_t div_q16(uint32_t inNum, uint32_t inDen){
+
+	uint32_t tmpWhole = inNum / inDen;
+	uint32_t tmpRem = inNum - tmpWhole * inDen;
+	uint16_t tmpFrac = 0;
+
+	for (uint8_t i = 0; i < 16; i++){
+		tmpRem <<= 1;
+		tmpFrac <<= 1;
+		if (tmpRem >= inDen){
+			tmpRem -= inDen;
+			tmpFrac |= 1;
+		}
+	}
+
+	return (tmpWhole << 16) | tmpFrac;
+}
+
+
+
+
+/*
+ * TIMER (ADC) FUNCTIONS
+ */
+static void init_timer_adc(){
+
+	/*
+	 * ::: NOTE :::	We are using ADC as a timer. Becuase the AT90PWM161 does not have a usable timer
+	 */
+	// First configure ADC "Digital Input Disable Register"
+	DIDR0 = 0;			// :::No channel for ADC sampling
+	DIDR1 = 0;
+
+
+
+	// As DIDR of the adc input is not disabled. Any value should be fine. Set ADC Multiplexer Register as regular
+	ADMUX  = _BV(REFS1) | _BV(REFS0)	// Internal 2.56V reference voltage with  PE3 pin free as port
+				| _BV(ADLAR)   			// left adjust result
+				| ADC_CH_AMP0;       	// initial input channel = AMP0
+
+	//
+	ADCSRB = 0 | _BV(ADHSM);	// high speed mode and auto trigger source = self
+
+
+	ADCSRA = _BV(ADEN)    		// enable ADC
+				| _BV(ADATE)   	// enable auto trigger
+				| _BV(ADIE)    	// enable interrupt
+				| _BV(ADPS0) | _BV(ADPS1) | _BV(ADPS2);	// prescaler = 128
+	ADCSRA &= ~(1<<ADIF);		// clear interrupt flag
+
+
+	/*
+	 * ::: NOTE :::	If we do not enable Amplifier, ADC conversion does not start.
+	 */
+	AMP0CSR = _BV(AMP0EN)		// Enable Amplifier
+				| _BV(AMP0GS);	// Use ground instead of AMP0-
+
+	_delay_us(9);         		// let the conversion start
+
+	sei();
+
+	ADCSRA |= (1<<ADSC);		// Start conversion
+
+	return;
+}
+
+
+static void init_cycle_counter(){
+
+	/*
+	 * ::: NOTE :::	Timer/Counter1 has no compare unit but it can run free at the IO clock.
+	 * 				It wraps every 65536 cycles (~8ms) which is far longer than one tick.
+	 */
+	TIMSK1 = 0;					// No interrupts
+	TCCR1B = _BV(CS10);			// clk_IO/1
+	TIFR1 = _BV(TOV1);			// Clear overflow flag
+
+	return;
+}
+
+
+// ADC interrupt service routine.
+ISR(ADC_vect)
+{
+	OTD_PROFILE_ISR_ENTER();
+
+	// Stamp the tick for sub-tick reads
+	sTickStamp = TCNT1 + sCycleSkew;
+
+	// Increment tick counter
+	uint32_t tmpTick = sUptimeTick + 1;
+	sUptimeTick = tmpTick;
+
+	// Sample CPU load
+	if (sIsSleeping){
+		sIdleTicks = sIdleTicks + 1;
+		sWindowIdleTicks = sWindowIdleTicks + 1;
+	}
+	if (((uint16_t)tmpTick & (LOAD_WINDOW_TICKS - 1)) == 0){
+		sLastWindowIdleTicks = sWindowIdleTicks;
+		sWindowIdleTicks = 0;
+	}
+
+	// Add the calibrated tick period
+	uint8_t tmpWhole = sTickWhole_us;
+	uint16_t tmpUsFraction = sUsFraction + sTickFraction;
+	if (tmpUsFraction < sTickFraction){
+		tmpWhole = tmpWhole + 1;
+	}
+	sUsFraction = tmpUsFraction;
+	sUptimeUs = sUptimeUs + tmpWhole;
+
+	/*
+	 * ::: NOTE :::	Collect tick periods and carry into the millisecond counter. So, getUptime_ms()
+	 * 				does not need a multiply or a divide.
+	 */
+	uint16_t tmpFraction = sMsFraction_us + tmpWhole;
+	if (tmpFraction >= 1000){
+		tmpFraction -= 1000;
+		sUptimeMs = sUptimeMs + 1;
+		sMsFraction_us = tmpFraction;
+
+		// Millisecond hooks
+		for (uint8_t i = 0; i < sMsHookCount; i++){
+			sMsHook[i]();
+		}
+	}else{
+		sMsFraction_us = tmpFraction;
+	}
+
+	// Tick hooks
+	for (uint8_t i = 0; i < sTickHookCount; i++){
+		sTickHook[i]();
+	}
+
+	OTD_PROFILE_ISR_EXIT(OTD_PROFILE_ISR_ADC);
+}
+
+
+
+#ifdef __cplusplus
+}
+#endif
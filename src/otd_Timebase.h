@@ -0,0 +1,108 @@
+/**
+  ******************************************************************************
+  * @file    otd_Timebase.h
+  * @author  OtomaDUINO Team
+  * @brief   This file contains uptime clock and cycle counter functions prototypes and data types.
+  ******************************************************************************
+  * @attention
+  *
+  * Copyright (c) 2022 ML-VPN.
+  * All rights reserved.
+  *
+  * This software is licensed under terms that can be found in the LICENSE file
+  * in the root directory of this software component.
+  * If no LICENSE file comes with this software, it is provided AS-IS.
+  *
+  ******************************************************************************
+  */
+
+#ifndef OTD_TIMEBASE_H_
+#define OTD_TIMEBASE_H_
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+#include <stdint.h>
+
+
+/*
+ * ::: NOTE :::	ADC runs free as the system tick. Every conversion complete interrupt is one tick.
+ */
+#define OTD_TICK_PERIOD_US		128
+// Maximum number of functions called from the tick interrupt on every millisecond
+#ifndef OTD_MS_HOOK_MAX
+#define OTD_MS_HOOK_MAX			4
+#endif
+// Maximum number of functions called from the tick interrupt on every tick
+#ifndef OTD_TICK_HOOK_MAX
+#define OTD_TICK_HOOK_MAX		2
+#endif
+// EEPROM location of the calibrated tick period (6 bytes)
+#ifndef OTD_EEADDR_TIMEBASE_TRIM
+#define OTD_EEADDR_TIMEBASE_TRIM	0x00
+#endif
+
+
+/*
+ * ::: NOTE :::	All counters are unsigned and wrap to zero.
+ * 				ticks wrap after ~6.4 days, ms after ~49.7 days and us after ~71.6 minutes.
+ * 				Always compare time stamps by unsigned subtraction, "(now - lastTS) >= diff",
+ * 				which stays correct across a wrap as long as the difference fits in 32 bits.
+ */
+struct OTD_UPTIME {
+	uint32_t tick;
+	uint32_t ms;
+	uint32_t us;
+};
+
+
+enum OTD_CALIB_SOURCE{
+	OTD_CALIB_SRC_UART_RX = 0,		// Start bit of every received byte
+	OTD_CALIB_SRC_EXTERNAL			// Application calls otd_TimebaseCalibEdge() on its reference edge
+};
+
+
+enum OTD_IDLE_MODE{
+	OTD_IDLE_MODE_IDLE = 0,			// CPU stops, all peripherals keep running
+	OTD_IDLE_MODE_ADC_NR			// IO clock stops too. Only used while pulse outputs are stopped
+};
+
+
+void otd_InitTimebase();
+unsigned long getUptime_ms();
+uint32_t getUptime_us();
+uint32_t getUptime_ticks();
+void getUptime(struct OTD_UPTIME *outUptime);
+uint16_t otd_GetCycleCount();
+/*
+ * ::: NOTE :::	Timer/Counter1 overflow is also used as a bit timer (soft UART). Use these to move the counter,
+ * 				they keep the cycle count and sub-tick reads continuous. Call with interrupts masked.
+ */
+void otd_CycleTimerStart(uint16_t inCycles);
+void otd_CycleTimerReload(uint16_t inCycles);
+// Hooks run in interrupt context, keep them short. Tick hooks even shorter, they run every 128us
+int8_t otd_AddMsHook(void (*inHook)(void));
+int8_t otd_AddTickHook(void (*inHook)(void));
+// IDLE
+void otd_SetIdleMode(enum OTD_IDLE_MODE inIdleMode);
+void otd_SetIdleHook(void (*inHook)(void));
+void otd_Idle();
+uint32_t otd_GetIdleTicks();
+uint16_t otd_GetCpuLoad();
+// CALIBRATION
+void otd_TimebaseCalibStart(enum OTD_CALIB_SOURCE inSource, uint16_t inRefPeriod_ms);
+void otd_TimebaseCalibEdge(enum OTD_CALIB_SOURCE inSource);
+uint16_t otd_TimebaseCalibEdgeCount();
+int8_t otd_TimebaseCalibFinish();
+int8_t otd_SetTimebaseTrim(uint32_t inTickPeriod_q16);
+uint32_t otd_GetTimebaseTrim();
+int8_t otd_TimebaseTrimLoad();
+void otd_TimebaseTrimSave();
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* OTD_TIMEBASE_H_ */
@@ -0,0 +1,316 @@
+/**
+  ******************************************************************************
+  * @file    otd_Timer.cpp
+  * @author  OtomaDUINO Team
+  * @brief   This file contains software timer functions.
+  ******************************************************************************
+  * @attention
+  *
+  * Copyright (c) 2022 ML-VPN.
+  * All rights reserved.
+  *
+  * This software is licensed under terms that can be found in the LICENSE file
+  * in the root directory of this software component.
+  * If no LICENSE file comes with this software, it is provided AS-IS.
+  *
+  ******************************************************************************
+  */
+
+#include "otd_Timer.h"
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#include "otd_Timebase.h"
+#include "otd_Memory.h"
+
+
+static_assert(OTD_TIMER_MAX <= 8, "OTD_TIMER_MAX must fit in the pending mask");
+
+#define TIMER_NONE		0xFF
+
+/*
+ * ::: NOTE :::	Active timers are kept in a delta list sorted by expiry. Each entry stores the
+ * 				milliseconds after the previous entry. So, the tick only decrements the head.
+ * 				An expired periodic timer is not re-inserted in the tick, which would walk the list
+ * 				in the interrupt. The tick stamps it and otd_TimerDispatch() puts it back.
+ */
+static void (*sCallback[OTD_TIMER_MAX])(void);
+static uint16_t sPeriod_ms[OTD_TIMER_MAX];		// Zero for one-shot
+static uint16_t sDelta_ms[OTD_TIMER_MAX];
+static uint8_t sNext[OTD_TIMER_MAX];
+static uint8_t sHead = TIMER_NONE;
+static volatile uint8_t sActiveMask = 0;
+static volatile uint8_t sPendingMask = 0;
+static volatile uint8_t sRearmMask = 0;		// Periodic timers expired and out of the list
+static uint16_t sExpiry_ms[OTD_TIMER_MAX];		// Tick count of the expiry, for sRearmMask
+static volatile uint16_t sTick_ms = 0;
+static uint8_t sTimerCount = 0;
+static uint8_t sIsHooked = 0;
+// Reported by otd_Memory
+const uint16_t otd_RamUsage_Timer = sizeof(sCallback) + sizeof(sPeriod_ms) + sizeof(sDelta_ms) + sizeof(sNext)
+									+ sizeof(sExpiry_ms);
+
+
+static void timer_tick();
+static void list_insert(uint8_t inTimerId, uint16_t inTime_ms);
+static void list_remove(uint8_t inTimerId);
+static void timer_rearm(uint8_t inRearm);
+
+
+
+void otd_InitTimer(){
+
+	uint8_t oldSREG = SREG;
+	cli();
+	sHead = TIMER_NONE;
+	sActiveMask = 0;
+	sPendingMask = 0;
+	sRearmMask = 0;
+	sTimerCount = 0;
+	SREG = oldSREG;
+
+	if (sIsHooked == 0){
+		if (otd_AddMsHook(timer_tick) == 0){
+			sIsHooked = 1;
+		}
+	}
+
+	return;
+}
+
+
+
+int8_t otd_TimerCreate(void (*inCallback)(void)){
+
+	if (sTimerCount >= OTD_TIMER_MAX){
+		return -1;
+	}
+
+	int8_t timerId = sTimerCount;
+	sCallback[timerId] = inCallback;
+	sPeriod_ms[timerId] = 0;
+	sTimerCount = sTimerCount + 1;
+
+	return timerId;
+}
+
+
+
+void otd_TimerStart(uint8_t inTimerId, uint16_t inTime_ms, uint8_t inIsPeriodic){
+
+	if (inTimerId >= sTimerCount){
+		return;
+	}
+	if (inTime_ms == 0){
+		inTime_ms = 1;
+	}
+
+	uint8_t oldSREG = SREG;
+	cli();
+	// Restart if it is already running
+	if (sActiveMask & (1 << inTimerId)){
+		list_remove(inTimerId);
+	}
+	sPendingMask &= ~(1 << inTimerId);
+	sRearmMask &= ~(1 << inTimerId);
+	sPeriod_ms[inTimerId] = (inIsPeriodic == 1) ? inTime_ms : 0;
+	list_insert(inTimerId, inTime_ms);
+	sActiveMask |= (1 << inTimerId);
+	SREG = oldSREG;
+
+	return;
+}
+
+
+
+void otd_TimerStop(uint8_t inTimerId){
+
+	if (inTimerId >= sTimerCount){
+		return;
+	}
+
+	uint8_t oldSREG = SREG;
+	cli();
+	if (sActiveMask & (1 << inTimerId)){
+		list_remove(inTimerId);
+		sActiveMask &= ~(1 << inTimerId);
+	}
+	sPendingMask &= ~(1 << inTimerId);
+	sRearmMask &= ~(1 << inTimerId);
+	SREG = oldSREG;
+
+	return;
+}
+
+
+
+uint8_t otd_TimerIsActive(uint8_t inTimerId){
+
+	if (inTimerId >= sTimerCount){
+		return 0;
+	}
+	if (sActiveMask & (1 << inTimerId)){
+		return 1;
+	}
+
+	return 0;
+}
+
+
+
+uint8_t otd_TimerDispatch(){
+
+	uint8_t tmpPending;
+	uint8_t tmpRearm;
+	uint8_t runCount = 0;
+
+	// Take the pending callbacks
+	uint8_t oldSREG = SREG;
+	cli();
+	tmpPending = sPendingMask;
+	sPendingMask = 0;
+	tmpRearm = sRearmMask;
+	SREG = oldSREG;
+
+	if (tmpRearm != 0){
+		timer_rearm(tmpRearm);
+	}
+
+	for (uint8_t i = 0; tmpPending != 0; i++, tmpPending >>= 1){
+		if ((tmpPending & 1) && sCallback[i] != 0){
+			sCallback[i]();
+			runCount = runCount + 1;
+		}
+	}
+
+	return runCount;
+}
+
+
+
+// Called from the tick interrupt on every millisecond
+static void timer_tick(){
+
+	sTick_ms = sTick_ms + 1;
+	if (sHead == TIMER_NONE){
+		return;
+	}
+	if (sDelta_ms[sHead] > 1){
+		sDelta_ms[sHead] = sDelta_ms[sHead] - 1;
+		return;
+	}
+	sDelta_ms[sHead] = 0;
+
+	// Expire every timer which is due now
+	while (sHead != TIMER_NONE && sDelta_ms[sHead] == 0){
+		uint8_t curId = sHead;
+		sHead = sNext[curId];
+
+		sPendingMask |= (1 << curId);
+		if (sPeriod_ms[curId] != 0){
+			// Stays active, otd_TimerDispatch() re-arms it from this stamp
+			sExpiry_ms[curId] = sTick_ms;
+			sRearmMask |= (1 << curId);
+		}else{
+			sActiveMask &= ~(1 << curId);
+		}
+	}
+
+	return;
+}
+
+
+// Puts the expired periodic timers back in the list, relative to their expiry so they do not drift
+static void timer_rearm(uint8_t inRearm){
+
+	for (uint8_t i = 0; inRearm != 0; i++, inRearm >>= 1){
+		if ((inRearm & 1) == 0){
+			continue;
+		}
+
+		// One insert per masked section, the list walk is at most OTD_TIMER_MAX entries
+		uint8_t oldSREG = SREG;
+		cli();
+		// Stopped or restarted since it was taken
+		if (sRearmMask & (1 << i)){
+			uint16_t elapsed_ms = sTick_ms - sExpiry_ms[i];
+			// Dispatch was late by whole periods, those expiries are merged into this one
+			if (elapsed_ms >= sPeriod_ms[i]){
+				elapsed_ms = elapsed_ms % sPeriod_ms[i];
+			}
+			list_insert(i, sPeriod_ms[i] - elapsed_ms);
+			sRearmMask &= ~(1 << i);
+		}
+		SREG = oldSREG;
+	}
+
+	return;
+}
+
+
+// Call with interrupts masked
+static void list_insert(uint8_t inTimerId, uint16_t inTime_ms){
+
+	uint8_t prevId = TIMER_NONE;
+	uint8_t curId = sHead;
+
+	// Timers with the same expiry stay in start order
+	while (curId != TIMER_NONE && sDelta_ms[curId] <= inTime_ms){
+		inTime_ms -= sDelta_ms[curId];
+		prevId = curId;
+		curId = sNext[curId];
+	}
+
+	sDelta_ms[inTimerId] = inTime_ms;
+	sNext[inTimerId] = curId;
+	if (curId != TIMER_NONE){
+		sDelta_ms[curId] -= inTime_ms;
+	}
+	if (prevId == TIMER_NONE){
+		sHead = inTimerId;
+	}else{
+		sNext[prevId] = inTimerId;
+	}
+
+	return;
+}
+
+
+// Call with interrupts masked
+static void list_remove(uint8_t inTimerId){
+
+	uint8_t prevId = TIMER_NONE;
+	uint8_t curId = sHead;
+
+	while (curId != TIMER_NONE && curId != inTimerId){
+		prevId = curId;
+		curId = sNext[curId];
+	}
+	if (curId == TIMER_NONE){
+		return;
+	}
+
+	// Give the remaining time to the next timer
+	uint8_t nextId = sNext[curId];
+	if (nextId != TIMER_NONE){
+		sDelta_ms[nextId] += sDelta_ms[curId];
+	}
+	if (prevId == TIMER_NONE){
+		sHead = nextId;
+	}else{
+		sNext[prevId] = nextId;
+	}
+
+	return;
+}
+
+
+
+#ifdef __cplusplus
+}
+#endif
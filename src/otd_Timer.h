@@ -0,0 +1,52 @@
+/**
+  ******************************************************************************
+  * @file    otd_Timer.h
+  * @author  OtomaDUINO Team
+  * @brief   This file contains software timer functions prototypes and data types.
+  ******************************************************************************
+  * @attention
+  *
+  * Copyright (c) 2022 ML-VPN.
+  * All rights reserved.
+  *
+  * This software is licensed under terms that can be found in the LICENSE file
+  * in the root directory of this software component.
+  * If no LICENSE file comes with this software, it is provided AS-IS.
+  *
+  ******************************************************************************
+  */
+
+#ifndef OTD_TIMER_H_
+#define OTD_TIMER_H_
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+#include <stdint.h>
+
+
+// At most 8 timers, pending callbacks are kept in a bit mask
+#ifndef OTD_TIMER_MAX
+#define OTD_TIMER_MAX		6
+#endif
+
+
+/*
+ * ::: NOTE :::	Timers expire in the millisecond tick interrupt. Callbacks are not called from the interrupt,
+ * 				they run from otd_TimerDispatch() in the main loop. Callback can be null, then poll otd_TimerIsActive().
+ * 				Periodic timers are re-armed by otd_TimerDispatch(), so call it also for periodic timers without callback.
+ */
+void otd_InitTimer();
+int8_t otd_TimerCreate(void (*inCallback)(void));
+void otd_TimerStart(uint8_t inTimerId, uint16_t inTime_ms, uint8_t inIsPeriodic);
+void otd_TimerStop(uint8_t inTimerId);
+uint8_t otd_TimerIsActive(uint8_t inTimerId);
+uint8_t otd_TimerDispatch();
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* OTD_TIMER_H_ */